@@ -4,7 +4,9 @@
 #include <expected>
 #include <filesystem>
 #include <iostream>
+#include "PhotoEncoder.h"
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 static std::string simplifyName(char *path)
@@ -25,7 +27,10 @@ enum class ProgOptStatus
 	MaintainRatioBothSpecified,
 	MaintainRatioNoSize,
 	MissingArgument,
-	TooManySizes
+	TooManySizes,
+	InvalidJobOrder,
+	InvalidOutputFormat,
+	InvalidQuality
 };
 
 static po::options_description addOptions()
@@ -38,7 +43,8 @@ static po::options_description addOptions()
 		("maintain-ratio", "Maintain the current ratio of width to height")
 		("scale-factor", po::value<unsigned int>(),
 			"The new size of the photo as a percentage of the old size")
-		("source-dir", po::value<std::string>(), "Where to find the original photos")
+		("source-dir", po::value<std::string>(),
+			"Where to find the original photos, either a directory or a ZIP or TAR archive")
 		("save-dir", po::value<std::string>(), "Where to save the resized photos")
 		("extend-filename", po::value<std::string>(),
 			"Add the specified string to the resized photo")
@@ -47,7 +53,41 @@ static po::options_description addOptions()
 		("all-jpg-files", "Process all the JPEG format photos")
 		("all-png-files", "Process all the PNG format photos")
 		("display-resized", "Show the resized photo")
+		("use-exif-thumbnail",
+			"Resize the thumbnail embedded in a JPEG photo when it is large enough")
+		("output-format", po::value<std::string>(),
+			"Save the resized photos as jpeg, png, webp or avif, the default is the input format")
+		("jpeg-quality", po::value<int>(), "JPEG quality from 0 to 100")
+		("png-compression", po::value<int>(), "PNG compression level from 0 to 9")
+		("webp-quality", po::value<int>(), "WebP quality from 1 to 100, above 100 is lossless")
+		("avif-quality", po::value<int>(), "AVIF quality from 0 to 100")
+		("max-bytes", po::value<std::size_t>(),
+			"Save each photo at the highest JPEG, WebP or AVIF quality that fits in this many bytes")
 		("time-resize", "Time the resizing of the photos")
+		("cache-dir", po::value<std::string>(),
+			"Reuse previously resized photos stored in this directory")
+		("cache-size-mb", po::value<std::size_t>(),
+			"The maximum size of the rendition cache in megabytes, 0 is unlimited")
+		("cache-hardlink",
+			"Hardlink cached photos into the save directory rather than copying them, "
+			"editing such a photo in place also changes the cache")
+		("pack-file", po::value<std::string>(),
+			"Append the resized photos to pack files with this base name instead of separate files")
+		("pack-size-mb", po::value<std::size_t>(),
+			"Start a new pack file when a pack reaches this many megabytes, 0 is unlimited")
+		("verify-pack", "Check every photo in the pack files against its checksum after resizing")
+		("progress", "Show the progress, throughput and estimated time remaining")
+		("metrics-file", po::value<std::string>(),
+			"Periodically write Prometheus format metrics to this file")
+		("metrics-interval", po::value<unsigned int>(),
+			"Seconds between updates of the metrics file")
+		("threads", po::value<unsigned int>(),
+			"The number of photos to resize at the same time, the default is one per CPU")
+		("intra-image-mp", po::value<std::size_t>(),
+			"Photos of at least this many megapixels are resized one at a time using every thread, 0 disables")
+		("pin-threads", "Pin each worker thread to a CPU, spread across NUMA nodes")
+		("job-order", po::value<std::string>(),
+			"The order photos are resized in: directory, largest-first or disk-locality")
 	;
 
 	return options;
@@ -105,7 +145,9 @@ static auto checkFileOptionsWithArguments(po::variables_map& inputOptions) ->
 	{
 		{"save-dir", &fileOptions.targetDirectory},
 		{"source-dir", &fileOptions.sourceDirectory},
-		{"extend-filename", &fileOptions.resizedPostfix}
+		{"extend-filename", &fileOptions.resizedPostfix},
+		{"cache-dir", &fileOptions.cacheDirectory},
+		{"pack-file", &fileOptions.packBaseName}
 	};
 	ProgOptStatus hasArguments = ProgOptStatus::NoErrors;
 	
@@ -165,6 +207,36 @@ static auto processFileOptions(po::variables_map& inputOptions) ->
 		fileOptions.overWriteFiles = true;
 	}
 
+	if (inputOptions.count("cache-size-mb"))
+	{
+		fileOptions.maxCacheMBytes = inputOptions["cache-size-mb"].as<std::size_t>();
+	}
+
+	if (inputOptions.count("cache-hardlink"))
+	{
+		fileOptions.hardlinkFromCache = true;
+	}
+
+	if (inputOptions.count("pack-size-mb"))
+	{
+		fileOptions.maxPackMBytes = inputOptions["pack-size-mb"].as<std::size_t>();
+	}
+
+	if (inputOptions.count("verify-pack"))
+	{
+		if (fileOptions.packBaseName.empty())
+		{
+			std::cerr << "--verify-pack is only used with --pack-file\n";
+		}
+		fileOptions.verifyPack = !fileOptions.packBaseName.empty();
+	}
+
+	if (!fileOptions.packBaseName.empty() && !fileOptions.cacheDirectory.empty())
+	{
+		std::cerr << "The rendition cache isn't used with --pack-file\n";
+		fileOptions.cacheDirectory.clear();
+	}
+
 	return fileOptions;
 }
 
@@ -191,6 +263,104 @@ static bool hasSize(po::variables_map& inputOptions)
 		inputOptions.count("scale-factor");
 }
 
+struct EncoderQualityOption
+{
+	std::string option;
+	int *value;
+	int minimum;
+	int maximum;
+};
+
+static auto processOutputFormat(po::variables_map& inputOptions) -> 
+	std::expected<OutputFormat, ProgOptStatus>
+{
+	const std::unordered_map<std::string, OutputFormat> outputFormats =
+	{
+		{"jpeg", OutputFormat::JPEG},
+		{"jpg", OutputFormat::JPEG},
+		{"png", OutputFormat::PNG},
+		{"webp", OutputFormat::WebP},
+		{"avif", OutputFormat::AVIF}
+	};
+
+	const auto formatName = hasArgument(inputOptions, "output-format");
+	if (!formatName.has_value())
+	{
+		return std::unexpected(formatName.error());
+	}
+
+	if (formatName->empty())
+	{
+		return OutputFormat::SameAsInput;
+	}
+
+	const auto outputFormat = outputFormats.find(*formatName);
+	if (outputFormat == outputFormats.end())
+	{
+		std::cerr << "Unknown --output-format \'" << *formatName << "\', use jpeg, png, webp or avif\n";
+		return std::unexpected(ProgOptStatus::InvalidOutputFormat);
+	}
+
+	if (!isOutputFormatSupported(outputFormat->second))
+	{
+		std::cerr << "The installed OpenCV can't write " << *formatName << " photos\n";
+		return std::unexpected(ProgOptStatus::InvalidOutputFormat);
+	}
+
+	return outputFormat->second;
+}
+
+static auto processEncoderOptions(po::variables_map& inputOptions) -> 
+	std::expected<EncoderOptions, ProgOptStatus>
+{
+	EncoderOptions encoderOptions;
+
+	if (const auto outputFormat = processOutputFormat(inputOptions); outputFormat.has_value())
+	{
+		encoderOptions.outputFormat = *outputFormat;
+	}
+	else
+	{
+		return std::unexpected(outputFormat.error());
+	}
+
+	std::vector<EncoderQualityOption> qualityOptions =
+	{
+		{"jpeg-quality", &encoderOptions.jpegQuality, 0, 100},
+		{"png-compression", &encoderOptions.pngCompression, 0, 9},
+		{"webp-quality", &encoderOptions.webpQuality, 1, 101},
+		{"avif-quality", &encoderOptions.avifQuality, 0, 100}
+	};
+
+	for (auto qualityOption: qualityOptions)
+	{
+		if (!inputOptions.count(qualityOption.option))
+		{
+			continue;
+		}
+
+		int value = inputOptions[qualityOption.option].as<int>();
+		if (value < qualityOption.minimum || value > qualityOption.maximum)
+		{
+			std::cerr << "--" << qualityOption.option << " must be from " << qualityOption.minimum <<
+				" to " << qualityOption.maximum << "\n";
+			return std::unexpected(ProgOptStatus::InvalidQuality);
+		}
+		*qualityOption.value = value;
+	}
+
+	if (inputOptions.count("max-bytes"))
+	{
+		encoderOptions.maxBytes = inputOptions["max-bytes"].as<std::size_t>();
+		if (encoderOptions.outputFormat == OutputFormat::PNG)
+		{
+			std::cerr << "PNG has no quality setting, --max-bytes only rejects PNG photos that are too large\n";
+		}
+	}
+
+	return encoderOptions;
+}
+
 static auto processPhotoOptions(po::variables_map& inputOptions) -> 
 	std::expected<PhotoOptions, ProgOptStatus>
 {
@@ -227,9 +397,105 @@ static auto processPhotoOptions(po::variables_map& inputOptions) ->
 		photoCtrl.displayResized = true;
 	}
 
+	if (inputOptions.count("use-exif-thumbnail"))
+	{
+		photoCtrl.useExifThumbnail = true;
+	}
+
+	if (const auto encoderOptions = processEncoderOptions(inputOptions); encoderOptions.has_value())
+	{
+		photoCtrl.encoderOptions = *encoderOptions;
+	}
+	else
+	{
+		return std::unexpected(encoderOptions.error());
+	}
+
 	return photoCtrl;
 }
 
+static auto processJobOrder(po::variables_map& inputOptions) -> 
+	std::expected<JobOrder, ProgOptStatus>
+{
+	const std::unordered_map<std::string, JobOrder> jobOrders =
+	{
+		{"directory", JobOrder::Directory},
+		{"largest-first", JobOrder::LargestFirst},
+		{"disk-locality", JobOrder::DiskLocality}
+	};
+
+	const auto jobOrderName = hasArgument(inputOptions, "job-order");
+	if (!jobOrderName.has_value())
+	{
+		return std::unexpected(jobOrderName.error());
+	}
+
+	if (jobOrderName->empty())
+	{
+		return JobOrder::Directory;
+	}
+
+	if (const auto jobOrder = jobOrders.find(*jobOrderName); jobOrder != jobOrders.end())
+	{
+		return jobOrder->second;
+	}
+
+	std::cerr << "Unknown --job-order \'" << *jobOrderName <<
+		"\', use directory, largest-first or disk-locality\n";
+	return std::unexpected(ProgOptStatus::InvalidJobOrder);
+}
+
+static auto processExecutionOptions(po::variables_map& inputOptions) -> 
+	std::expected<ExecutionOptions, ProgOptStatus>
+{
+	ExecutionOptions executionOptions;
+
+	if (const auto metricsFile = hasArgument(inputOptions, "metrics-file"); metricsFile.has_value())
+	{
+		executionOptions.metricsFile = *metricsFile;
+	}
+	else
+	{
+		return std::unexpected(metricsFile.error());
+	}
+
+	if (inputOptions.count("metrics-interval"))
+	{
+		executionOptions.metricsIntervalSeconds = inputOptions["metrics-interval"].as<unsigned int>();
+	}
+
+	if (inputOptions.count("progress"))
+	{
+		executionOptions.showProgress = true;
+	}
+
+	if (inputOptions.count("threads"))
+	{
+		executionOptions.workerThreads = inputOptions["threads"].as<unsigned int>();
+	}
+
+	if (inputOptions.count("intra-image-mp"))
+	{
+		executionOptions.intraImageMegapixels = inputOptions["intra-image-mp"].as<std::size_t>();
+	}
+
+	if (inputOptions.count("pin-threads"))
+	{
+		executionOptions.pinWorkers = true;
+	}
+
+	if (const auto jobOrder = processJobOrder(inputOptions); jobOrder.has_value())
+	{
+		executionOptions.jobOrder = *jobOrder;
+	}
+	else
+	{
+		return std::unexpected(jobOrder.error());
+	}
+
+	return executionOptions;
+}
+
 static auto processProgramOptions(po::variables_map& inputOptions,
 	const std::string& progName) -> std::expected<ProgramOptions, ProgOptStatus>
 {
@@ -249,12 +515,23 @@ static auto processProgramOptions(po::variables_map& inputOptions,
 	if (const auto fOptions = processFileOptions(inputOptions); fOptions.has_value())
 	{
 		programOptions.fileOptions = *fOptions;
+		programOptions.fileOptions.outputExtension =
+			outputFormatExtension(programOptions.photoOptions.encoderOptions.outputFormat);
 	}
 	else
 	{
 		return std::unexpected(fOptions.error());
 	}
 
+	if (const auto eOptions = processExecutionOptions(inputOptions); eOptions.has_value())
+	{
+		programOptions.executionOptions = *eOptions;
+	}
+	else
+	{
+		return std::unexpected(eOptions.error());
+	}
+
 	if (inputOptions.count("time-resize")) {
 		programOptions.enableExecutionTime = true;
 	}
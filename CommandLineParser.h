@@ -1,6 +1,7 @@
 #ifndef COMMAND_LINE_PARSER_H_
 #define COMMAND_LINE_PARSER_H_
 
+#include "ExecutionOptions.h"
 #include <expected>
 #include "FileOptions.h"
 #include "PhotoOptions.h"
@@ -12,6 +13,7 @@ struct ProgramOptions
 	bool enableExecutionTime = false;
     FileOptions fileOptions;
     PhotoOptions photoOptions;
+    ExecutionOptions executionOptions;
 };
 
 enum class CommandLineStatus
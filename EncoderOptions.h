@@ -0,0 +1,27 @@
+#ifndef ENCODER_OPTIONS_H_
+#define ENCODER_OPTIONS_H_
+
+#include <cstddef>
+
+enum class OutputFormat
+{
+    SameAsInput,
+    JPEG,
+    PNG,
+    WebP,
+    AVIF
+};
+
+// A value of -1 leaves the setting at the OpenCV default.
+struct EncoderOptions
+{
+    OutputFormat outputFormat = OutputFormat::SameAsInput;
+    int jpegQuality = -1;
+    int pngCompression = -1;
+    int webpQuality = -1;
+    int avifQuality = -1;
+    // The largest encoded photo in bytes, 0 is unlimited.
+    std::size_t maxBytes = 0;
+};
+
+#endif // ENCODER_OPTIONS_H_
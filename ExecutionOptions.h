@@ -0,0 +1,24 @@
+#ifndef EXECUTION_OPTIONS_H_
+#define EXECUTION_OPTIONS_H_
+
+#include <string>
+
+enum class JobOrder
+{
+    Directory,
+    LargestFirst,
+    DiskLocality
+};
+
+struct ExecutionOptions
+{
+    bool showProgress = false;
+    std::string metricsFile;
+    unsigned int metricsIntervalSeconds = 15;
+    unsigned int workerThreads = 0;
+    std::size_t intraImageMegapixels = 40;
+    bool pinWorkers = false;
+    JobOrder jobOrder = JobOrder::Directory;
+};
+
+#endif // EXECUTION_OPTIONS_H_
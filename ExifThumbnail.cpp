@@ -0,0 +1,207 @@
+#include <cstdint>
+#include <cstring>
+#include "ExifThumbnail.h"
+#include "ImageProbe.h"
+#include <optional>
+#include <vector>
+
+static const unsigned char exifHeader[] = {'E', 'x', 'i', 'f', 0, 0};
+
+static const std::uint16_t orientationTag = 0x0112;
+static const std::uint16_t thumbnailOffsetTag = 0x0201;
+static const std::uint16_t thumbnailLengthTag = 0x0202;
+
+static const std::size_t ifdEntrySize = 12;
+
+/*
+ * Bounds checked reads from the TIFF structure inside the EXIF segment, every
+ * offset is relative to the start of the TIFF header.
+ */
+class TiffReader
+{
+public:
+    TiffReader(const unsigned char* tiffStart, std::size_t tiffLength)
+        : tiff{tiffStart}, length{tiffLength}
+    {
+        littleEndian = length >= 2 && tiff[0] == 'I' && tiff[1] == 'I';
+    }
+
+    bool isValid() const
+    {
+        return length >= 8 && ((tiff[0] == 'I' && tiff[1] == 'I') || (tiff[0] == 'M' && tiff[1] == 'M'))
+            && read16(2) == 42;
+    }
+
+    bool contains(std::size_t offset, std::size_t byteCount) const
+    {
+        return offset <= length && byteCount <= length - offset;
+    }
+
+    std::uint16_t read16(std::size_t offset) const
+    {
+        if (!contains(offset, 2))
+        {
+            return 0;
+        }
+        return littleEndian ? static_cast<std::uint16_t>(tiff[offset] | (tiff[offset + 1] << 8)) :
+            static_cast<std::uint16_t>((tiff[offset] << 8) | tiff[offset + 1]);
+    }
+
+    std::uint32_t read32(std::size_t offset) const
+    {
+        std::uint32_t first = read16(offset);
+        std::uint32_t second = read16(offset + 2);
+        return littleEndian ? (second << 16) | first : (first << 16) | second;
+    }
+
+private:
+    const unsigned char* tiff;
+    std::size_t length;
+    bool littleEndian = false;
+};
+
+struct IfdEntryValue
+{
+    bool found = false;
+    std::uint32_t value = 0;
+};
+
+// SHORT values are stored in the first two bytes of the value field.
+static IfdEntryValue findIfdEntry(const TiffReader& tiff, std::size_t ifdOffset, std::uint16_t tag)
+{
+    IfdEntryValue entryValue;
+    std::uint16_t entryCount = tiff.read16(ifdOffset);
+
+    for (std::size_t entry = 0; entry < entryCount; ++entry)
+    {
+        std::size_t entryOffset = ifdOffset + 2 + entry * ifdEntrySize;
+        if (!tiff.contains(entryOffset, ifdEntrySize))
+        {
+            break;
+        }
+
+        if (tiff.read16(entryOffset) == tag)
+        {
+            const std::uint16_t shortType = 3;
+            entryValue.found = true;
+            entryValue.value = (tiff.read16(entryOffset + 2) == shortType) ?
+                tiff.read16(entryOffset + 8) : tiff.read32(entryOffset + 8);
+            break;
+        }
+    }
+
+    return entryValue;
+}
+
+static std::size_t findNextIfd(const TiffReader& tiff, std::size_t ifdOffset)
+{
+    std::size_t entryCount = tiff.read16(ifdOffset);
+    return tiff.read32(ifdOffset + 2 + entryCount * ifdEntrySize);
+}
+
+/*
+ * IFD0 holds the orientation of the photo, IFD1 describes the thumbnail.
+ * Returns false if there is no usable JPEG thumbnail.
+ */
+static bool parseExifSegment(const unsigned char* segment, std::size_t segmentLength,
+    std::size_t tiffStartInPhoto, ExifThumbnail& thumbnail)
+{
+    TiffReader tiff(segment, segmentLength);
+    if (!tiff.isValid())
+    {
+        return false;
+    }
+
+    std::size_t ifd0 = tiff.read32(4);
+    if (!tiff.contains(ifd0, 2))
+    {
+        return false;
+    }
+
+    if (IfdEntryValue orientation = findIfdEntry(tiff, ifd0, orientationTag);
+        orientation.found && orientation.value >= 1 && orientation.value <= 8)
+    {
+        thumbnail.orientation = orientation.value;
+    }
+
+    std::size_t ifd1 = findNextIfd(tiff, ifd0);
+    if (ifd1 == 0 || !tiff.contains(ifd1, 2))
+    {
+        return false;
+    }
+
+    IfdEntryValue thumbnailOffset = findIfdEntry(tiff, ifd1, thumbnailOffsetTag);
+    IfdEntryValue thumbnailLength = findIfdEntry(tiff, ifd1, thumbnailLengthTag);
+    if (!thumbnailOffset.found || !thumbnailLength.found || thumbnailLength.value == 0 ||
+        !tiff.contains(thumbnailOffset.value, thumbnailLength.value))
+    {
+        return false;
+    }
+
+    thumbnail.offset = tiffStartInPhoto + thumbnailOffset.value;
+    thumbnail.length = thumbnailLength.value;
+
+    return true;
+}
+
+/*
+ * The EXIF segment precedes the frame header, so both are found by walking
+ * the marker segments up to the start of scan.
+ */
+std::optional<ExifThumbnail> findExifThumbnail(const std::vector<unsigned char>& jpegPhoto)
+{
+    ExifThumbnail thumbnail;
+    bool hasThumbnail = false;
+    std::size_t position = 2;
+
+    if (jpegPhoto.size() < 4 || jpegPhoto[0] != 0xFF || jpegPhoto[1] != 0xD8)
+    {
+        return std::nullopt;
+    }
+
+    while (position + 4 <= jpegPhoto.size() && jpegPhoto[position] == 0xFF)
+    {
+        unsigned char marker = jpegPhoto[position + 1];
+        if (marker == 0xFF)
+        {
+            ++position;     // Fill byte
+            continue;
+        }
+
+        if (marker == 0xD9 || marker == 0xDA)
+        {
+            break;
+        }
+
+        std::size_t segmentLength = (jpegPhoto[position + 2] << 8) | jpegPhoto[position + 3];
+        std::size_t segmentData = position + 4;
+        if (segmentLength < 2 || segmentData + segmentLength - 2 > jpegPhoto.size())
+        {
+            break;
+        }
+
+        if (marker == 0xE1 && !hasThumbnail && segmentLength - 2 > sizeof(exifHeader) &&
+            std::memcmp(&jpegPhoto[segmentData], exifHeader, sizeof(exifHeader)) == 0)
+        {
+            std::size_t tiffStart = segmentData + sizeof(exifHeader);
+            hasThumbnail = parseExifSegment(&jpegPhoto[tiffStart],
+                segmentLength - 2 - sizeof(exifHeader), tiffStart, thumbnail);
+        }
+
+        if (isJpegStartOfFrame(marker) && segmentLength >= 7)
+        {
+            thumbnail.photoDimensions.height = (jpegPhoto[segmentData + 1] << 8) | jpegPhoto[segmentData + 2];
+            thumbnail.photoDimensions.width = (jpegPhoto[segmentData + 3] << 8) | jpegPhoto[segmentData + 4];
+            break;
+        }
+
+        position = segmentData + segmentLength - 2;
+    }
+
+    if (!hasThumbnail || thumbnail.photoDimensions.pixelCount() == 0)
+    {
+        return std::nullopt;
+    }
+
+    return thumbnail;
+}
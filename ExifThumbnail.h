@@ -0,0 +1,24 @@
+#ifndef EXIFTHUMBNAIL_H_
+#define EXIFTHUMBNAIL_H_
+
+/*
+ * Locate the preview JPEG that many cameras embed in the APP1 EXIF segment,
+ * along with the EXIF orientation and the dimensions of the full photo, by
+ * parsing the JPEG markers without decoding anything.
+ */
+
+#include "ImageProbe.h"
+#include <optional>
+#include <vector>
+
+struct ExifThumbnail
+{
+    std::size_t offset = 0;
+    std::size_t length = 0;
+    unsigned int orientation = 1;
+    ImageDimensions photoDimensions;
+};
+
+std::optional<ExifThumbnail> findExifThumbnail(const std::vector<unsigned char>& jpegPhoto);
+
+#endif // EXIFTHUMBNAIL_H_
@@ -13,6 +13,13 @@ struct FileOptions
     std::string targetDirectory;
 	std::string relocDirectory;
     std::string resizedPostfix;
+    std::string outputExtension;
+    std::string cacheDirectory;
+    std::size_t maxCacheMBytes = 1024;
+    bool hardlinkFromCache = false;
+    std::string packBaseName;
+    std::size_t maxPackMBytes = 1024;
+    bool verifyPack = false;
 };
 
 #endif // FILE_OPTIONS_H_
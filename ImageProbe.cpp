@@ -0,0 +1,123 @@
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include "ImageProbe.h"
+#include <optional>
+#include <string>
+
+static const std::array<unsigned char, 8> pngSignature = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+
+static std::uint32_t readBigEndian(std::ifstream& photo, int byteCount)
+{
+    std::uint32_t value = 0;
+
+    for (int i = 0; i < byteCount; ++i)
+    {
+        value = (value << 8) | static_cast<unsigned char>(photo.get());
+    }
+
+    return value;
+}
+
+// The IHDR chunk always immediately follows the PNG signature.
+static std::optional<ImageDimensions> probePNG(std::ifstream& photo)
+{
+    photo.seekg(pngSignature.size() + 8);
+    ImageDimensions dimensions;
+    dimensions.width = readBigEndian(photo, 4);
+    dimensions.height = readBigEndian(photo, 4);
+
+    if (!photo)
+    {
+        return std::nullopt;
+    }
+
+    return dimensions;
+}
+
+bool isJpegStartOfFrame(int marker)
+{
+    // SOF0 through SOF15 except DHT (C4), JPG (C8) and DAC (CC).
+    return marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+}
+
+/*
+ * Walk the marker segments after SOI until a start of frame segment is found,
+ * only the segment lengths are read.
+ */
+static std::optional<ImageDimensions> probeJPEG(std::ifstream& photo)
+{
+    photo.seekg(2);
+
+    while (photo)
+    {
+        if (photo.get() != 0xFF)
+        {
+            return std::nullopt;
+        }
+
+        int marker = photo.get();
+        while (marker == 0xFF)
+        {
+            marker = photo.get();
+        }
+
+        if (marker == 0xD9 || marker == 0xDA || marker == EOF)
+        {
+            // End of image or start of scan before any frame header.
+            return std::nullopt;
+        }
+
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7))
+        {
+            // Stand alone markers have no length.
+            continue;
+        }
+
+        std::uint32_t segmentLength = readBigEndian(photo, 2);
+        if (segmentLength < 2)
+        {
+            return std::nullopt;
+        }
+
+        if (isJpegStartOfFrame(marker))
+        {
+            photo.get();    // Sample precision
+            ImageDimensions dimensions;
+            dimensions.height = readBigEndian(photo, 2);
+            dimensions.width = readBigEndian(photo, 2);
+            if (!photo)
+            {
+                return std::nullopt;
+            }
+            return dimensions;
+        }
+
+        photo.seekg(segmentLength - 2, std::ios::cur);
+    }
+
+    return std::nullopt;
+}
+
+std::optional<ImageDimensions> probeImageDimensions(const std::string& fileName)
+{
+    std::ifstream photo(fileName, std::ios::binary);
+    std::array<unsigned char, pngSignature.size()> signature{};
+
+    if (!photo.read(reinterpret_cast<char*>(signature.data()), signature.size()))
+    {
+        return std::nullopt;
+    }
+
+    if (signature == pngSignature)
+    {
+        return probePNG(photo);
+    }
+
+    if (signature[0] == 0xFF && signature[1] == 0xD8)
+    {
+        return probeJPEG(photo);
+    }
+
+    return std::nullopt;
+}
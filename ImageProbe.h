@@ -0,0 +1,24 @@
+#ifndef IMAGEPROBE_H_
+#define IMAGEPROBE_H_
+
+/*
+ * Find the dimensions of a JPEG or PNG photo from its header without
+ * decoding the photo.
+ */
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+struct ImageDimensions
+{
+    std::size_t width = 0;
+    std::size_t height = 0;
+
+    std::uint64_t pixelCount() const noexcept { return static_cast<std::uint64_t>(width) * height; }
+};
+
+std::optional<ImageDimensions> probeImageDimensions(const std::string& fileName);
+bool isJpegStartOfFrame(int marker);
+
+#endif // IMAGEPROBE_H_
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fcntl.h>
+#include <filesystem>
+#include "ImageProbe.h"
+#include "JobScheduler.h"
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <optional>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <string>
+#include <system_error>
+#include <unistd.h>
+#include <vector>
+
+// The physical offset of the first extent of the file, when FIEMAP knows it.
+static std::optional<std::uint64_t> findPhysicalOffset(const std::string& fileName)
+{
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return std::nullopt;
+    }
+
+    alignas(fiemap) std::array<unsigned char, sizeof(fiemap) + sizeof(fiemap_extent)> request{};
+    auto* extentMap = reinterpret_cast<fiemap*>(request.data());
+    extentMap->fm_start = 0;
+    extentMap->fm_length = FIEMAP_MAX_OFFSET;
+    extentMap->fm_extent_count = 1;
+
+    std::optional<std::uint64_t> physicalOffset;
+
+    // A delayed allocation extent hasn't been given a place on the disk yet.
+    if (::ioctl(fd, FS_IOC_FIEMAP, extentMap) == 0 && extentMap->fm_mapped_extents > 0 &&
+        !(extentMap->fm_extents[0].fe_flags & FIEMAP_EXTENT_UNKNOWN))
+    {
+        physicalOffset = extentMap->fm_extents[0].fe_physical;
+    }
+
+    ::close(fd);
+
+    return physicalOffset;
+}
+
+/*
+ * Byte offsets and inode numbers can't be compared, so unless FIEMAP worked
+ * for every photo the whole run is ordered by inode number, the best
+ * available estimate of where a file is on the disk.
+ */
+static void setDiskLocationKeys(const PhotoFileList& photoList, std::vector<PhotoJob>& jobs)
+{
+    bool allMapped = true;
+
+    for (auto& job: jobs)
+    {
+        const auto physicalOffset = findPhysicalOffset(photoList[job.photoIndex].inputName());
+        if (!physicalOffset)
+        {
+            allMapped = false;
+            break;
+        }
+        job.key = *physicalOffset;
+    }
+
+    if (allMapped)
+    {
+        return;
+    }
+
+    for (auto& job: jobs)
+    {
+        struct stat fileStatus;
+        job.key = ::stat(photoList[job.photoIndex].inputName().c_str(), &fileStatus) == 0 ?
+            fileStatus.st_ino : 0;
+    }
+}
+
+/*
+ * Photos whose header can't be probed fall back to their file size when
+ * requested, this is of the same order of magnitude as the pixel count of a
+ * compressed photo.
+ */
+static void setPixelCountKeys(const PhotoFileList& photoList, std::vector<PhotoJob>& jobs,
+    bool estimateFromFileSize)
+{
+    for (auto& job: jobs)
+    {
+        const std::string inputName = photoList[job.photoIndex].inputName();
+        job.key = 0;
+
+        if (auto dimensions = probeImageDimensions(inputName))
+        {
+            job.key = dimensions->pixelCount();
+        }
+        else if (estimateFromFileSize)
+        {
+            std::error_code ec;
+            std::uintmax_t fileSize = std::filesystem::file_size(inputName, ec);
+            job.key = ec ? 0 : fileSize;
+        }
+    }
+}
+
+/*
+ * Reading the photo headers is one small read per file, except when they are
+ * needed to sort by size they are read in the scheduled order so disk
+ * locality ordering also applies to them.
+ */
+std::vector<PhotoJob> schedulePhotoJobs(const PhotoFileList& photoList, JobOrder jobOrder,
+    bool probePixelCounts)
+{
+    std::vector<PhotoJob> jobs(photoList.size());
+
+    for (std::size_t i = 0; i < jobs.size(); ++i)
+    {
+        jobs[i].photoIndex = static_cast<std::uint32_t>(i);
+    }
+
+    switch (jobOrder)
+    {
+    case JobOrder::LargestFirst:
+        setPixelCountKeys(photoList, jobs, true);
+        std::ranges::stable_sort(jobs, std::ranges::greater{}, &PhotoJob::key);
+        return jobs;
+    case JobOrder::DiskLocality:
+        setDiskLocationKeys(photoList, jobs);
+        std::ranges::stable_sort(jobs, {}, &PhotoJob::key);
+        break;
+    case JobOrder::Directory:
+        break;
+    }
+
+    if (probePixelCounts)
+    {
+        setPixelCountKeys(photoList, jobs, false);
+    }
+    else
+    {
+        std::ranges::for_each(jobs, [](PhotoJob& job) { job.key = 0; });
+    }
+
+    return jobs;
+}
@@ -0,0 +1,31 @@
+#ifndef JOBSCHEDULER_H_
+#define JOBSCHEDULER_H_
+
+/*
+ * Decide the order the photos are resized in. Largest first ordering lowers
+ * the makespan of a parallel run by not leaving the biggest photos to the
+ * end, disk locality ordering reads the photos in the order they are stored
+ * on the disk to avoid seeking on rotational media.
+ */
+
+#include <cstdint>
+#include "ExecutionOptions.h"
+#include "PhotoFileList.h"
+#include <vector>
+
+/*
+ * Runs can have millions of photos so a job is only the photo and one key.
+ * The jobs are sorted by the key, once scheduled it is the estimated
+ * processing cost in pixels when the photo headers were probed and 0
+ * otherwise.
+ */
+struct PhotoJob
+{
+    std::uint32_t photoIndex = 0;
+    std::uint64_t key = 0;
+};
+
+std::vector<PhotoJob> schedulePhotoJobs(const PhotoFileList& photoList, JobOrder jobOrder,
+    bool probePixelCounts);
+
+#endif // JOBSCHEDULER_H_
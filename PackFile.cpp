@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <boost/crc.hpp>
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include "PackFile.h"
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+static const std::string_view packExtension = ".pack";
+static const std::string_view indexExtension = ".idx";
+
+static std::string makePackFileName(const std::string& packBaseName, std::size_t packNumber,
+    std::string_view extension)
+{
+    char number[8];
+    std::snprintf(number, sizeof(number), "-%04zu", packNumber);
+
+    return packBaseName + number + std::string(extension);
+}
+
+static std::uint32_t calculateChecksum(const unsigned char* data, std::size_t length)
+{
+    boost::crc_32_type crc;
+    crc.process_bytes(data, length);
+
+    return crc.checksum();
+}
+
+static bool writeAll(int fd, const void* data, std::size_t length)
+{
+    auto bytes = static_cast<const unsigned char*>(data);
+
+    while (length > 0)
+    {
+        ssize_t written = ::write(fd, bytes, length);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        length -= static_cast<std::size_t>(written);
+    }
+
+    return true;
+}
+
+/*
+ * A process that crashed while writing an index line left it without its new
+ * line, end that line so the next entry isn't joined onto it.
+ */
+static bool terminateIndex(int indexFd)
+{
+    struct stat indexStatus;
+    if (::fstat(indexFd, &indexStatus) != 0)
+    {
+        return false;
+    }
+    if (indexStatus.st_size == 0)
+    {
+        return true;
+    }
+
+    char lastCharacter = '\n';
+    if (::pread(indexFd, &lastCharacter, 1, indexStatus.st_size - 1) != 1)
+    {
+        return false;
+    }
+
+    return lastCharacter == '\n' || writeAll(indexFd, "\n", 1);
+}
+
+/*
+ * Continue appending to the last existing pack of this name, a new run adds
+ * to the pack rather than replacing it.
+ */
+PackWriter::PackWriter(const std::string& packBaseName, std::uint64_t maxPackBytes)
+    : baseName{packBaseName}, maxBytes{maxPackBytes}
+{
+    std::error_code ec;
+    while (std::filesystem::exists(makePackFileName(baseName, packNumber + 1, packExtension), ec))
+    {
+        ++packNumber;
+    }
+
+    if (!openPack(packNumber))
+    {
+        std::cerr << "Could not open the pack file " << makePackFileName(baseName, packNumber, packExtension)
+            << "!\n";
+    }
+}
+
+PackWriter::~PackWriter()
+{
+    closePack();
+}
+
+bool PackWriter::openPack(std::size_t number)
+{
+    closePack();
+    packNumber = number;
+
+    packFd = ::open(makePackFileName(baseName, packNumber, packExtension).c_str(),
+        O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    indexFd = ::open(makePackFileName(baseName, packNumber, indexExtension).c_str(),
+        O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+
+    return isOpen();
+}
+
+void PackWriter::closePack()
+{
+    if (packFd >= 0)
+    {
+        ::close(packFd);
+        packFd = -1;
+    }
+    if (indexFd >= 0)
+    {
+        ::close(indexFd);
+        indexFd = -1;
+    }
+}
+
+/*
+ * The pack file is locked while appending so other processes writing to the
+ * same pack can't interleave. The data is written before its index line, a
+ * crash in between leaves unreferenced bytes rather than a bad index entry.
+ * The lock also covers ending a line left unfinished by a crashed writer.
+ */
+bool PackWriter::append(std::string_view name, const std::vector<unsigned char>& encodedPhoto,
+    unsigned int width, unsigned int height)
+{
+    if (name.find_first_of("\t\n") != std::string_view::npos)
+    {
+        std::cerr << "Can't add " << name << " to the pack, the name contains a tab or new line!\n";
+        return false;
+    }
+
+    // Only the offset depends on the pack, the rest of the index line is made before locking it.
+    const std::uint32_t checksum = calculateChecksum(encodedPhoto.data(), encodedPhoto.size());
+    char checksumText[16];
+    std::snprintf(checksumText, sizeof(checksumText), "%08x", static_cast<unsigned int>(checksum));
+    const std::string indexLineEnd = "\t" + std::to_string(encodedPhoto.size()) + "\t" + std::to_string(width) +
+        "\t" + std::to_string(height) + "\t" + checksumText + "\n";
+
+    std::lock_guard<std::mutex> appendLock(appendMutex);
+
+    if (!isOpen())
+    {
+        return false;
+    }
+
+    while (true)
+    {
+        if (::flock(packFd, LOCK_EX) != 0)
+        {
+            return false;
+        }
+
+        off_t packSize = ::lseek(packFd, 0, SEEK_END);
+        if (packSize < 0)
+        {
+            ::flock(packFd, LOCK_UN);
+            return false;
+        }
+
+        const bool packIsFull = maxBytes > 0 && packSize > 0 &&
+            static_cast<std::uint64_t>(packSize) + encodedPhoto.size() > maxBytes;
+        if (!packIsFull)
+        {
+            std::string indexLine(name);
+            indexLine += "\t" + std::to_string(packSize) + indexLineEnd;
+
+            bool appended = terminateIndex(indexFd) &&
+                writeAll(packFd, encodedPhoto.data(), encodedPhoto.size()) &&
+                writeAll(indexFd, indexLine.data(), indexLine.size());
+            ::flock(packFd, LOCK_UN);
+
+            return appended;
+        }
+
+        ::flock(packFd, LOCK_UN);
+        if (!openPack(packNumber + 1))
+        {
+            std::cerr << "Could not open the pack file " <<
+                makePackFileName(baseName, packNumber, packExtension) << "!\n";
+            return false;
+        }
+    }
+}
+
+static bool parseNumber(std::string_view field, std::uint64_t& value, int base = 10)
+{
+    auto [end, error] = std::from_chars(field.data(), field.data() + field.size(), value, base);
+
+    return error == std::errc() && end == field.data() + field.size();
+}
+
+static std::optional<std::pair<std::string, PackIndexEntry>> parseIndexLine(std::string_view line,
+    std::size_t packNumber)
+{
+    std::vector<std::string_view> fields;
+    std::size_t fieldStart = 0;
+
+    for (std::size_t tab = line.find('\t'); tab != std::string_view::npos; tab = line.find('\t', fieldStart))
+    {
+        fields.push_back(line.substr(fieldStart, tab - fieldStart));
+        fieldStart = tab + 1;
+    }
+    fields.push_back(line.substr(fieldStart));
+
+    const std::size_t indexFieldCount = 6;
+    if (fields.size() != indexFieldCount)
+    {
+        return std::nullopt;
+    }
+
+    PackIndexEntry entry;
+    std::uint64_t width;
+    std::uint64_t height;
+    std::uint64_t checksum;
+    entry.packNumber = packNumber;
+    if (!parseNumber(fields[1], entry.offset) || !parseNumber(fields[2], entry.length) ||
+        !parseNumber(fields[3], width) || !parseNumber(fields[4], height) ||
+        !parseNumber(fields[5], checksum, 16))
+    {
+        return std::nullopt;
+    }
+    entry.width = static_cast<unsigned int>(width);
+    entry.height = static_cast<unsigned int>(height);
+    entry.checksum = static_cast<std::uint32_t>(checksum);
+
+    return std::make_pair(std::string(fields[0]), entry);
+}
+
+PackReader::PackReader(const std::string& packBaseName)
+{
+    std::error_code ec;
+
+    for (std::size_t packNumber = 0;
+        std::filesystem::exists(makePackFileName(packBaseName, packNumber, packExtension), ec); ++packNumber)
+    {
+        MappedPack pack;
+        int packFd = ::open(makePackFileName(packBaseName, packNumber, packExtension).c_str(),
+            O_RDONLY | O_CLOEXEC);
+        struct stat packStatus;
+        if (packFd >= 0 && ::fstat(packFd, &packStatus) == 0 && packStatus.st_size > 0)
+        {
+            pack.length = static_cast<std::size_t>(packStatus.st_size);
+            pack.data = ::mmap(nullptr, pack.length, PROT_READ, MAP_SHARED, packFd, 0);
+            if (pack.data == MAP_FAILED)
+            {
+                pack.data = nullptr;
+                pack.length = 0;
+            }
+        }
+        if (packFd >= 0)
+        {
+            ::close(packFd);
+        }
+        packs.push_back(pack);
+
+        std::ifstream indexFile(makePackFileName(packBaseName, packNumber, indexExtension));
+        std::string line;
+        while (std::getline(indexFile, line))
+        {
+            if (auto indexEntry = parseIndexLine(line, packNumber))
+            {
+                index.insert_or_assign(std::move(indexEntry->first), indexEntry->second);
+            }
+        }
+    }
+}
+
+PackReader::~PackReader()
+{
+    for (auto& pack: packs)
+    {
+        if (pack.data)
+        {
+            ::munmap(pack.data, pack.length);
+        }
+    }
+}
+
+std::optional<PackIndexEntry> PackReader::find(const std::string& name) const
+{
+    if (auto entry = index.find(name); entry != index.end())
+    {
+        return entry->second;
+    }
+
+    return std::nullopt;
+}
+
+std::span<const unsigned char> PackReader::read(const PackIndexEntry& entry) const
+{
+    if (entry.packNumber >= packs.size())
+    {
+        return {};
+    }
+
+    const MappedPack& pack = packs[entry.packNumber];
+    if (!pack.data || entry.offset > pack.length || entry.length > pack.length - entry.offset)
+    {
+        return {};
+    }
+
+    std::span<const unsigned char> rendition(static_cast<const unsigned char*>(pack.data) + entry.offset,
+        entry.length);
+    if (calculateChecksum(rendition.data(), rendition.size()) != entry.checksum)
+    {
+        return {};
+    }
+
+    return rendition;
+}
+
+std::vector<std::string> PackReader::findDamaged() const
+{
+    std::vector<std::string> damaged;
+
+    for (const auto& [name, entry]: index)
+    {
+        if (read(entry).empty() && entry.length > 0)
+        {
+            damaged.push_back(name);
+        }
+    }
+    std::ranges::sort(damaged);
+
+    return damaged;
+}
@@ -0,0 +1,89 @@
+#ifndef PACKFILE_H_
+#define PACKFILE_H_
+
+/*
+ * Pack output stores many encoded renditions in a few large pack files
+ * instead of one file per photo. Every pack file basename-NNNN.pack has a
+ * sidecar text index basename-NNNN.idx with one line per rendition:
+ *
+ *     name <tab> offset <tab> length <tab> width <tab> height <tab> crc32
+ *
+ * Renditions are only ever appended, so a later run can add to an existing
+ * pack and several processes can append to the same packs. When a name
+ * appears more than once the last entry wins.
+ */
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct PackIndexEntry
+{
+    std::size_t packNumber = 0;
+    std::uint64_t offset = 0;
+    std::uint64_t length = 0;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    std::uint32_t checksum = 0;
+};
+
+class PackWriter
+{
+public:
+    PackWriter(const std::string& packBaseName, std::uint64_t maxPackBytes);
+    ~PackWriter();
+    PackWriter(const PackWriter&) = delete;
+    PackWriter& operator=(const PackWriter&) = delete;
+
+    bool isOpen() const noexcept { return packFd >= 0 && indexFd >= 0; }
+    bool append(std::string_view name, const std::vector<unsigned char>& encodedPhoto,
+        unsigned int width, unsigned int height);
+
+private:
+    bool openPack(std::size_t number);
+    void closePack();
+
+    const std::string baseName;
+    const std::uint64_t maxBytes;
+    std::size_t packNumber = 0;
+    int packFd = -1;
+    int indexFd = -1;
+    std::mutex appendMutex;
+};
+
+/*
+ * Random access to the renditions in a set of packs, the pack files are
+ * memory mapped so reading a rendition doesn't copy it.
+ */
+class PackReader
+{
+public:
+    explicit PackReader(const std::string& packBaseName);
+    ~PackReader();
+    PackReader(const PackReader&) = delete;
+    PackReader& operator=(const PackReader&) = delete;
+
+    std::size_t size() const noexcept { return index.size(); }
+    std::optional<PackIndexEntry> find(const std::string& name) const;
+    // An empty span when the rendition is outside the pack or fails its checksum.
+    std::span<const unsigned char> read(const PackIndexEntry& entry) const;
+    // The names of the renditions read() can't return, in name order.
+    std::vector<std::string> findDamaged() const;
+
+private:
+    struct MappedPack
+    {
+        void* data = nullptr;
+        std::size_t length = 0;
+    };
+
+    std::vector<MappedPack> packs;
+    std::unordered_map<std::string, PackIndexEntry> index;
+};
+
+#endif // PACKFILE_H_
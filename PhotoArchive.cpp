@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include "PhotoArchive.h"
+#include <string>
+#include <system_error>
+#include <vector>
+
+#ifdef HAVE_LIBARCHIVE
+#include <archive.h>
+#include <archive_entry.h>
+#endif
+
+static const std::size_t archiveBlockSize = 1024 * 1024;
+
+// The member size comes from the archive header, a corrupt header must not cause a huge allocation.
+static const std::size_t maxInitialMemberAllocation = 64 * 1024 * 1024;
+
+// Any file given as the photo source is treated as an archive.
+bool PhotoArchive::isArchive(const std::filesystem::path& sourcePath)
+{
+    std::error_code ec;
+    return std::filesystem::is_regular_file(sourcePath, ec);
+}
+
+#ifdef HAVE_LIBARCHIVE
+
+PhotoArchive::PhotoArchive(const std::string& archiveName)
+    : name{archiveName}
+{
+    reader = archive_read_new();
+    archive_read_support_filter_all(reader);
+    archive_read_support_format_zip(reader);
+    archive_read_support_format_tar(reader);
+    archive_read_support_format_gnutar(reader);
+
+    if (archive_read_open_filename(reader, name.c_str(), archiveBlockSize) != ARCHIVE_OK)
+    {
+        std::cerr << "Could not open the photo archive " << name << ": " <<
+            archive_error_string(reader) << "\n";
+        archive_read_free(reader);
+        reader = nullptr;
+    }
+}
+
+PhotoArchive::~PhotoArchive()
+{
+    if (reader)
+    {
+        archive_read_free(reader);
+    }
+}
+
+/*
+ * The data of the current member is skipped by libarchive if it wasn't read,
+ * for an uncompressed archive that is a seek.
+ */
+bool PhotoArchive::nextMember(std::string& memberName)
+{
+    if (!reader)
+    {
+        return false;
+    }
+
+    archive_entry* entry;
+    int status;
+    while ((status = archive_read_next_header(reader, &entry)) == ARCHIVE_OK || status == ARCHIVE_WARN)
+    {
+        if (archive_entry_filetype(entry) == AE_IFREG && archive_entry_pathname(entry))
+        {
+            memberName = archive_entry_pathname(entry);
+            memberSize = archive_entry_size_is_set(entry) ?
+                static_cast<std::size_t>(archive_entry_size(entry)) : 0;
+            return true;
+        }
+    }
+
+    if (status != ARCHIVE_EOF)
+    {
+        std::cerr << "Error reading the photo archive " << name << ": " <<
+            archive_error_string(reader) << "\n";
+    }
+
+    return false;
+}
+
+bool PhotoArchive::readMember(std::vector<unsigned char>& contents)
+{
+    contents.clear();
+
+    if (!reader)
+    {
+        return false;
+    }
+
+    /*
+     * The size in the header is only a hint, some archive formats don't record
+     * it. The buffer grows as the data arrives.
+     */
+    std::size_t bytesRead = 0;
+    la_ssize_t readStatus;
+    contents.resize(memberSize > 0 ? std::min(memberSize, maxInitialMemberAllocation) : archiveBlockSize);
+    do
+    {
+        if (bytesRead == contents.size())
+        {
+            contents.resize(contents.size() + std::max(contents.size(), archiveBlockSize));
+        }
+        readStatus = archive_read_data(reader, contents.data() + bytesRead, contents.size() - bytesRead);
+        if (readStatus > 0)
+        {
+            bytesRead += static_cast<std::size_t>(readStatus);
+        }
+    } while (readStatus > 0);
+
+    contents.resize(bytesRead);
+
+    if (readStatus < 0)
+    {
+        std::cerr << "Error reading the photo archive " << name << ": " <<
+            archive_error_string(reader) << "\n";
+        return false;
+    }
+
+    return true;
+}
+
+#else
+
+PhotoArchive::PhotoArchive(const std::string& archiveName)
+    : name{archiveName}
+{
+    std::cerr << "Can't read the photo archive " << name <<
+        ", this program was built without libarchive\n";
+}
+
+PhotoArchive::~PhotoArchive()
+{
+}
+
+bool PhotoArchive::nextMember(std::string&)
+{
+    return false;
+}
+
+bool PhotoArchive::readMember(std::vector<unsigned char>& contents)
+{
+    contents.clear();
+    return false;
+}
+
+#endif // HAVE_LIBARCHIVE
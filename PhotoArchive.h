@@ -0,0 +1,38 @@
+#ifndef PHOTOARCHIVE_H_
+#define PHOTOARCHIVE_H_
+
+/*
+ * Sequential reader for the members of a ZIP or TAR archive, optionally
+ * compressed. The members are visited in the order they are stored so a
+ * whole archive is read in one streaming pass without extracting it.
+ * Requires libarchive; without it every archive fails to open.
+ */
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct archive;
+
+class PhotoArchive
+{
+public:
+    explicit PhotoArchive(const std::string& archiveName);
+    ~PhotoArchive();
+    PhotoArchive(const PhotoArchive&) = delete;
+    PhotoArchive& operator=(const PhotoArchive&) = delete;
+
+    bool isOpen() const noexcept { return reader != nullptr; }
+    // Advance to the next regular file in the archive.
+    bool nextMember(std::string& memberName);
+    bool readMember(std::vector<unsigned char>& contents);
+
+    static bool isArchive(const std::filesystem::path& sourcePath);
+
+private:
+    std::string name;
+    struct archive* reader = nullptr;
+    std::size_t memberSize = 0;
+};
+
+#endif // PHOTOARCHIVE_H_
@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <cctype>
+#include "EncoderOptions.h"
+#include <filesystem>
+#include <opencv2/opencv.hpp>
+#include <optional>
+#include "PhotoEncoder.h"
+#include <string>
+#include <utility>
+#include <vector>
+
+// OpenCV added the AVIF encoder parameters in 4.10.
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 10)
+#define PHOTO_ENCODER_HAS_AVIF 1
+#endif
+
+static constexpr int maxTrialEncodesPerRound = 4;
+
+struct QualitySetting
+{
+    int parameter;
+    int minimum;
+    int maximum;
+};
+
+static std::string lowerCaseExtension(const std::string& outputName)
+{
+    std::string extension = std::filesystem::path(outputName).extension().string();
+    std::ranges::transform(extension, extension.begin(), [](unsigned char c) { return std::tolower(c); });
+
+    return extension;
+}
+
+/*
+ * The quality range of the lossy encoders, the maximum is the quality the
+ * user asked for. PNG compression is lossless and has no quality setting.
+ */
+static std::optional<QualitySetting> findQualitySetting(const EncoderOptions& encoderOptions,
+    const std::string& extension)
+{
+    auto requestedQuality = [](int quality) { return quality >= 0 ? quality : 100; };
+
+    if (extension == ".jpg" || extension == ".jpeg")
+    {
+        return QualitySetting{cv::IMWRITE_JPEG_QUALITY, 0, requestedQuality(encoderOptions.jpegQuality)};
+    }
+    if (extension == ".webp")
+    {
+        return QualitySetting{cv::IMWRITE_WEBP_QUALITY, 1, requestedQuality(encoderOptions.webpQuality)};
+    }
+#ifdef PHOTO_ENCODER_HAS_AVIF
+    if (extension == ".avif")
+    {
+        return QualitySetting{cv::IMWRITE_AVIF_QUALITY, 0, requestedQuality(encoderOptions.avifQuality)};
+    }
+#endif
+
+    return std::nullopt;
+}
+
+std::string outputFormatExtension(OutputFormat outputFormat)
+{
+    switch (outputFormat)
+    {
+    case OutputFormat::JPEG:
+        return ".jpg";
+    case OutputFormat::PNG:
+        return ".png";
+    case OutputFormat::WebP:
+        return ".webp";
+    case OutputFormat::AVIF:
+        return ".avif";
+    case OutputFormat::SameAsInput:
+        break;
+    }
+
+    return "";
+}
+
+/*
+ * The encoders available depend on the libraries the local OpenCV was built
+ * with.
+ */
+bool isOutputFormatSupported(OutputFormat outputFormat)
+{
+    if (outputFormat == OutputFormat::SameAsInput)
+    {
+        return true;
+    }
+
+#ifndef PHOTO_ENCODER_HAS_AVIF
+    if (outputFormat == OutputFormat::AVIF)
+    {
+        return false;
+    }
+#endif
+
+    return cv::haveImageWriter("photo" + outputFormatExtension(outputFormat));
+}
+
+/*
+ * The parameters are chosen by the extension of the output file so the
+ * quality settings also apply when the output format is the input format.
+ */
+std::vector<int> makeEncoderParameters(const EncoderOptions& encoderOptions, const std::string& outputName)
+{
+    std::vector<int> parameters;
+    const std::string extension = lowerCaseExtension(outputName);
+
+    auto addParameter = [&parameters](int parameter, int value) {
+        if (value >= 0)
+        {
+            parameters.push_back(parameter);
+            parameters.push_back(value);
+        }
+    };
+
+    if (extension == ".jpg" || extension == ".jpeg")
+    {
+        addParameter(cv::IMWRITE_JPEG_QUALITY, encoderOptions.jpegQuality);
+    }
+    else if (extension == ".png")
+    {
+        addParameter(cv::IMWRITE_PNG_COMPRESSION, encoderOptions.pngCompression);
+    }
+    else if (extension == ".webp")
+    {
+        addParameter(cv::IMWRITE_WEBP_QUALITY, encoderOptions.webpQuality);
+    }
+#ifdef PHOTO_ENCODER_HAS_AVIF
+    else if (extension == ".avif")
+    {
+        addParameter(cv::IMWRITE_AVIF_QUALITY, encoderOptions.avifQuality);
+    }
+#endif
+
+    return parameters;
+}
+
+/*
+ * The requested quality is tried first because most photos fit. Otherwise
+ * each round of the search encodes up to maxTrialEncodesPerRound qualities
+ * with cv::parallel_for_, so the trial encodes follow the cv::setNumThreads()
+ * setting of the resize: a k-ary search for a large photo that has the whole
+ * machine, a binary search while every worker resizes its own photo.
+ */
+BudgetEncodedPhoto encodeWithinByteBudget(const cv::Mat& photo, const EncoderOptions& encoderOptions,
+    const std::string& outputName)
+{
+    BudgetEncodedPhoto budgetPhoto;
+    const std::string extension = lowerCaseExtension(outputName);
+    const std::vector<int> requestedParameters = makeEncoderParameters(encoderOptions, outputName);
+    const std::optional<QualitySetting> qualitySetting = findQualitySetting(encoderOptions, extension);
+
+    auto encode = [&](int quality, std::vector<unsigned char>& encodedPhoto) {
+        std::vector<int> parameters;
+        if (qualitySetting.has_value())
+        {
+            parameters = {qualitySetting->parameter, quality};
+        }
+        else
+        {
+            parameters = requestedParameters;
+        }
+
+        if (!cv::imencode(extension, photo, encodedPhoto, parameters))
+        {
+            encodedPhoto.clear();
+        }
+    };
+
+    auto fitsBudget = [&encoderOptions](const std::vector<unsigned char>& encodedPhoto) {
+        return !encodedPhoto.empty() &&
+            (encoderOptions.maxBytes == 0 || encodedPhoto.size() <= encoderOptions.maxBytes);
+    };
+
+    const int requestedQuality = qualitySetting.has_value() ? qualitySetting->maximum : -1;
+    std::vector<unsigned char> encodedPhoto;
+    encode(requestedQuality, encodedPhoto);
+    budgetPhoto.trialEncodes = 1;
+
+    if (fitsBudget(encodedPhoto))
+    {
+        budgetPhoto.photo = std::move(encodedPhoto);
+        budgetPhoto.quality = requestedQuality;
+        return budgetPhoto;
+    }
+    if (!qualitySetting.has_value())
+    {
+        return budgetPhoto;
+    }
+
+    int lowest = qualitySetting->minimum;
+    int highest = requestedQuality - 1;
+    while (lowest <= highest)
+    {
+        // Spread the trial qualities evenly over the range still in question.
+        const int rangeSize = highest - lowest + 1;
+        const int roundSize = std::min({rangeSize, std::max(cv::getNumThreads(), 1), maxTrialEncodesPerRound});
+        std::vector<int> qualities(static_cast<std::size_t>(roundSize));
+        for (int trial = 0; trial < roundSize; ++trial)
+        {
+            qualities[trial] = (rangeSize == roundSize) ? lowest + trial :
+                lowest + rangeSize * (trial + 1) / (roundSize + 1);
+        }
+
+        std::vector<std::vector<unsigned char>> trialPhotos(qualities.size());
+        cv::parallel_for_(cv::Range(0, roundSize), [&](const cv::Range& trials) {
+            for (int trial = trials.start; trial < trials.end; ++trial)
+            {
+                encode(qualities[trial], trialPhotos[trial]);
+            }
+        });
+        budgetPhoto.trialEncodes += static_cast<unsigned int>(roundSize);
+
+        int bestTrial = roundSize - 1;
+        while (bestTrial >= 0 && !fitsBudget(trialPhotos[bestTrial]))
+        {
+            --bestTrial;
+        }
+
+        if (bestTrial < 0)
+        {
+            highest = qualities.front() - 1;
+            continue;
+        }
+
+        budgetPhoto.photo = std::move(trialPhotos[bestTrial]);
+        budgetPhoto.quality = qualities[bestTrial];
+        lowest = qualities[bestTrial] + 1;
+        if (bestTrial + 1 < roundSize)
+        {
+            highest = qualities[bestTrial + 1] - 1;
+        }
+    }
+
+    return budgetPhoto;
+}
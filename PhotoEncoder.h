@@ -0,0 +1,26 @@
+#ifndef PHOTOENCODER_H_
+#define PHOTOENCODER_H_
+
+#include "EncoderOptions.h"
+#include <opencv2/core.hpp>
+#include <string>
+#include <vector>
+
+/*
+ * The result of searching for the highest quality that fits the byte budget,
+ * the photo is empty when even the lowest quality is too large.
+ */
+struct BudgetEncodedPhoto
+{
+    std::vector<unsigned char> photo;
+    int quality = -1;
+    unsigned int trialEncodes = 0;
+};
+
+std::string outputFormatExtension(OutputFormat outputFormat);
+bool isOutputFormatSupported(OutputFormat outputFormat);
+std::vector<int> makeEncoderParameters(const EncoderOptions& encoderOptions, const std::string& outputName);
+BudgetEncodedPhoto encodeWithinByteBudget(const cv::Mat& photo, const EncoderOptions& encoderOptions,
+    const std::string& outputName);
+
+#endif // PHOTOENCODER_H_
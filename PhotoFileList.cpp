@@ -0,0 +1,107 @@
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include "PhotoFileList.h"
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+std::string PhotoFile::joinPath(std::string_view directory, std::string_view fileName)
+{
+    std::string path;
+
+    path.reserve(directory.size() + 1 + fileName.size());
+    path.append(directory);
+    if (!path.empty() && path.back() != std::filesystem::path::preferred_separator)
+    {
+        path += std::filesystem::path::preferred_separator;
+    }
+    path.append(fileName);
+
+    return path;
+}
+
+void PhotoFileList::addPhoto(std::string_view inputDirectory, std::string_view inputFileName,
+    std::string_view outputDirectory, std::string_view outputFileName)
+{
+    if (inputFileName.size() > std::numeric_limits<std::uint16_t>::max() ||
+        outputFileName.size() > std::numeric_limits<std::uint16_t>::max())
+    {
+        throw std::length_error("Photo file name too long: " + std::string(inputFileName));
+    }
+
+    Entry entry;
+    entry.inputDirectory = internDirectory(inputDirectory);
+    entry.outputDirectory = internDirectory(outputDirectory);
+    entry.inputNameOffset = appendToArena(inputFileName);
+    entry.inputNameLength = static_cast<std::uint16_t>(inputFileName.size());
+    entry.outputNameOffset = appendToArena(outputFileName);
+    entry.outputNameLength = static_cast<std::uint16_t>(outputFileName.size());
+
+    entries.push_back(entry);
+}
+
+PhotoFile PhotoFileList::operator[](std::size_t index) const
+{
+    const Entry& entry = entries[index];
+
+    return PhotoFile(directories[entry.inputDirectory],
+        arenaName(entry.inputNameOffset, entry.inputNameLength),
+        directories[entry.outputDirectory],
+        arenaName(entry.outputNameOffset, entry.outputNameLength));
+}
+
+std::size_t PhotoFileList::memoryUsage() const noexcept
+{
+    // Each node of the index holds the next pointer, the key and value and the cached hash.
+    const std::size_t indexNodeSize =
+        sizeof(void*) + sizeof(decltype(directoryIndexes)::value_type) + sizeof(std::size_t);
+
+    std::size_t bytesUsed = sizeof(*this) + entries.capacity() * sizeof(Entry) + nameArena.capacity() +
+        directories.capacity() * sizeof(std::string) + directoryIndexes.bucket_count() * sizeof(void*) +
+        directoryIndexes.size() * indexNodeSize;
+
+    for (const auto& directory: directories)
+    {
+        // Once for the directory table and once for the index.
+        bytesUsed += 2 * directory.capacity();
+    }
+
+    return bytesUsed;
+}
+
+/*
+ * Looking the directory up as a string_view first means no string is built
+ * for the directories already seen, which is almost every photo.
+ */
+std::uint32_t PhotoFileList::internDirectory(std::string_view directory)
+{
+    if (auto directoryIndex = directoryIndexes.find(directory); directoryIndex != directoryIndexes.end())
+    {
+        return directoryIndex->second;
+    }
+
+    auto directoryIndex = static_cast<std::uint32_t>(directories.size());
+    directories.emplace_back(directory);
+    directoryIndexes.emplace(directory, directoryIndex);
+
+    return directoryIndex;
+}
+
+std::uint32_t PhotoFileList::appendToArena(std::string_view fileName)
+{
+    if (nameArena.size() + fileName.size() > std::numeric_limits<std::uint32_t>::max())
+    {
+        throw std::length_error("Too many photos, the file name arena is full");
+    }
+
+    auto offset = static_cast<std::uint32_t>(nameArena.size());
+    nameArena.append(fileName);
+
+    return offset;
+}
+
+std::string_view PhotoFileList::arenaName(std::uint32_t offset, std::uint16_t length) const
+{
+    return std::string_view(nameArena).substr(offset, length);
+}
@@ -1,15 +1,91 @@
 #ifndef PHOTOFILELIST_H_
 #define PHOTOFILELIST_H_
 
+/*
+ * The input and output names of every photo to resize. Runs can have
+ * millions of photos, so the directory names are interned and the file names
+ * are stored in one contiguous arena; each photo costs a small fixed size
+ * entry plus the characters of its file names. PhotoFile is a view into the
+ * list, the full path names are only built when a photo is processed.
+ */
+
+#include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
-struct PhotoFile
+class PhotoFile
 {
-    std::string inputName;
-    std::string outputName;
+public:
+    PhotoFile(std::string_view inputDirectory, std::string_view inputFileName,
+        std::string_view outputDirectory, std::string_view outputFileName)
+        : inDirectory{inputDirectory}, inFileName{inputFileName},
+        outDirectory{outputDirectory}, outFileName{outputFileName}
+    {
+    }
+
+    std::string inputName() const { return joinPath(inDirectory, inFileName); }
+    // Empty when the output file already exists and --overwrite wasn't specified.
+    std::string outputName() const { return hasOutput() ? joinPath(outDirectory, outFileName) : std::string(); }
+    bool hasOutput() const noexcept { return !outFileName.empty(); }
+    std::string_view inputDirectory() const noexcept { return inDirectory; }
+    std::string_view inputFileName() const noexcept { return inFileName; }
+    std::string_view outputDirectory() const noexcept { return outDirectory; }
+    std::string_view outputFileName() const noexcept { return outFileName; }
+
+private:
+    static std::string joinPath(std::string_view directory, std::string_view fileName);
+
+    std::string_view inDirectory;
+    std::string_view inFileName;
+    std::string_view outDirectory;
+    std::string_view outFileName;
 };
 
-using PhotoFileList = std::vector<PhotoFile>;
+class PhotoFileList
+{
+public:
+    void addPhoto(std::string_view inputDirectory, std::string_view inputFileName,
+        std::string_view outputDirectory, std::string_view outputFileName);
+
+    PhotoFile operator[](std::size_t index) const;
+    std::size_t size() const noexcept { return entries.size(); }
+    bool empty() const noexcept { return entries.empty(); }
+    // An estimate, the allocator's own overhead per allocation isn't known.
+    std::size_t memoryUsage() const noexcept;
+
+private:
+    // Lets the directory index be searched with a string_view.
+    struct DirectoryHash
+    {
+        using is_transparent = void;
+
+        std::size_t operator()(std::string_view directory) const noexcept
+        {
+            return std::hash<std::string_view>{}(directory);
+        }
+    };
+
+    struct Entry
+    {
+        std::uint32_t inputDirectory;
+        std::uint32_t outputDirectory;
+        std::uint32_t inputNameOffset;
+        std::uint32_t outputNameOffset;
+        std::uint16_t inputNameLength;
+        std::uint16_t outputNameLength;
+    };
+
+    std::uint32_t internDirectory(std::string_view directory);
+    std::uint32_t appendToArena(std::string_view fileName);
+    std::string_view arenaName(std::uint32_t offset, std::uint16_t length) const;
+
+    std::vector<Entry> entries;
+    std::vector<std::string> directories;
+    std::unordered_map<std::string, std::uint32_t, DirectoryHash, std::equal_to<>> directoryIndexes;
+    std::string nameArena;
+};
 
 #endif // PHOTOFILELIST_H_
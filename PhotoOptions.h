@@ -1,6 +1,7 @@
 #ifndef PHOTO_OPTIONS_H_
 #define PHOTO_OPTIONS_H_
 
+#include "EncoderOptions.h"
 #include <string>
 
 struct PhotoOptions
@@ -12,6 +13,8 @@ struct PhotoOptions
     std::size_t maxHeight = 0;
     std::size_t minHeight = 0;
     unsigned int scaleFactor = 0;
+    bool useExifThumbnail = false;
+    EncoderOptions encoderOptions;
 };
 
 #endif // PHOTO_OPTIONS_H_
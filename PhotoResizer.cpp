@@ -1,7 +1,34 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include "ExecutionOptions.h"
+#include "ExifThumbnail.h"
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include "JobScheduler.h"
+#include <limits>
+#include <mutex>
 #include <opencv2/opencv.hpp>
+#include <optional>
+#include "PackFile.h"
+#include "PhotoArchive.h"
+#include "PhotoEncoder.h"
+#include "photofilefinder.h"
 #include "PhotoOptions.h"
 #include "PhotoFileList.h"
 #include "PhotoResizer.h"
+#include "ProgressMetrics.h"
+#include "RenditionCache.h"
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include "WorkerAffinity.h"
 
 static cv::Mat resizePhoto(cv::Mat& photo, const std::size_t newWdith, const std::size_t newHeight)
 {
@@ -54,13 +81,61 @@ static cv::Mat resizePhotoByPercentage(cv::Mat& photo, const unsigned int percen
     return resizePhoto(photo, newWidth, newHeight);
 }
 
-static bool saveResizedPhoto(cv::Mat& resizedPhoto, const std::string webSafeName)
+/*
+ * With --max-bytes the photo is encoded in memory at the highest quality that
+ * fits the budget, the result is empty if no quality fits.
+ */
+static std::vector<unsigned char> encodeWithinBudget(const cv::Mat& resizedPhoto, const std::string& outputName,
+    const EncoderOptions& encoderOptions, ProgressMetrics& metrics)
 {
+    BudgetEncodedPhoto budgetPhoto = encodeWithinByteBudget(resizedPhoto, encoderOptions, outputName);
+    metrics.addTrialEncodes(budgetPhoto.trialEncodes);
 
-    bool saved = cv::imwrite(webSafeName, resizedPhoto);
+    if (budgetPhoto.photo.empty())
+    {
+        std::cerr << "Photo " << outputName << " does not fit in " << encoderOptions.maxBytes <<
+            " bytes at any quality!\n";
+    }
+
+    return std::move(budgetPhoto.photo);
+}
+
+static bool saveResizedPhoto(cv::Mat& resizedPhoto, const std::string webSafeName,
+    const std::vector<int>& encoderParameters, const EncoderOptions& encoderOptions, ProgressMetrics& metrics)
+{
+    /*
+     * Replace rather than truncate an existing output, it may be a hardlink
+     * into the rendition cache.
+     */
+    std::error_code ec;
+    std::filesystem::remove(webSafeName, ec);
+
+    bool saved = false;
+    if (encoderOptions.maxBytes > 0)
+    {
+        std::vector<unsigned char> encodedPhoto =
+            encodeWithinBudget(resizedPhoto, webSafeName, encoderOptions, metrics);
+        if (encodedPhoto.empty())
+        {
+            resizedPhoto.release();
+            return false;
+        }
+
+        std::ofstream photoFile(webSafeName, std::ios::binary | std::ios::trunc);
+        photoFile.write(reinterpret_cast<const char*>(encodedPhoto.data()),
+            static_cast<std::streamsize>(encodedPhoto.size()));
+        photoFile.close();
+        saved = !photoFile.fail();
+    }
+    else
+    {
+        saved = cv::imwrite(webSafeName, resizedPhoto, encoderParameters);
+    }
 
     if (!saved) {
         std::cerr << "Could not write photo " << webSafeName << " to file!\n";
+        // Don't leave a truncated photo behind.
+        std::filesystem::remove(webSafeName, ec);
     }
 
     // Prevent memory leak.
@@ -69,6 +144,41 @@ static bool saveResizedPhoto(cv::Mat& resizedPhoto, const std::string webSafeNam
     return saved;
 }
 
+/*
+ * Encode in memory and append the rendition to the pack under its output file
+ * name. Returns the number of bytes added to the pack, 0 on failure.
+ */
+static std::uint64_t savePackedPhoto(cv::Mat& resizedPhoto, const PhotoFile& photoFile,
+    const std::vector<int>& encoderParameters, const EncoderOptions& encoderOptions, ProgressMetrics& metrics,
+    PackWriter& packWriter)
+{
+    std::vector<unsigned char> encodedPhoto;
+    std::string extension = std::filesystem::path(photoFile.outputFileName()).extension().string();
+
+    bool encoded = false;
+    if (encoderOptions.maxBytes > 0)
+    {
+        encodedPhoto = encodeWithinBudget(resizedPhoto, photoFile.outputName(), encoderOptions, metrics);
+        encoded = !encodedPhoto.empty();
+    }
+    else
+    {
+        encoded = cv::imencode(extension, resizedPhoto, encodedPhoto, encoderParameters);
+    }
+
+    bool packed = encoded && packWriter.append(photoFile.outputFileName(), encodedPhoto,
+        static_cast<unsigned int>(resizedPhoto.cols), static_cast<unsigned int>(resizedPhoto.rows));
+
+    if (!packed) {
+        std::cerr << "Could not add photo " << photoFile.outputFileName() << " to the pack!\n";
+    }
+
+    // Prevent memory leak.
+    resizedPhoto.release();
+
+    return packed ? encodedPhoto.size() : 0;
+}
+
 static cv::Mat resizeByUserSpecification(cv::Mat& photo, const PhotoOptions& photoOptions)
 {
     if (photoOptions.maxWdith > 0 && photoOptions.maxHeight > 0)
@@ -110,43 +220,753 @@ static cv::Mat resizeByUserSpecification(cv::Mat& photo, const PhotoOptions& pho
     return photo;
 }
 
-static bool resizeAndSavePhoto(const PhotoFile& photoFile, const PhotoOptions& photoOptions)
+/*
+ * The size resizeByUserSpecification() will produce from a photo of
+ * photoSize, photoSize itself when the photo won't be resized.
+ */
+static cv::Size calculateResizedSize(const cv::Size photoSize, const PhotoOptions& photoOptions)
 {
-    // Possibly file already exists and user did not specify --overwrite
-    if (photoFile.outputName.empty())
+    const std::size_t photoWidth = static_cast<std::size_t>(photoSize.width);
+    const std::size_t photoHeight = static_cast<std::size_t>(photoSize.height);
+
+    if (photoOptions.maxWdith > 0 && photoOptions.maxHeight > 0)
     {
-        return false;
+        return cv::Size(photoOptions.maxWdith, photoOptions.maxHeight);
+    }
+
+    if (photoOptions.scaleFactor > 0)
+    {
+        double percentMult = static_cast<double>(photoOptions.scaleFactor)/100.0;
+        return cv::Size(static_cast<int>(photoWidth * percentMult), static_cast<int>(photoHeight * percentMult));
+    }
+
+    if (photoOptions.maxWdith > 0 && photoWidth > photoOptions.maxWdith)
+    {
+        double ratio = static_cast<double>(photoOptions.maxWdith) / static_cast<double>(photoWidth);
+        return cv::Size(photoOptions.maxWdith, static_cast<int>(photoHeight * ratio));
+    }
+
+    if (photoOptions.maxHeight > 0 && photoHeight > photoOptions.maxHeight)
+    {
+        double ratio = static_cast<double>(photoOptions.maxHeight) / static_cast<double>(photoHeight);
+        return cv::Size(static_cast<int>(photoWidth * ratio), photoOptions.maxHeight);
+    }
+
+    return photoSize;
+}
+
+// The EXIF orientation tag values are defined by the TIFF 6.0 specification.
+static cv::Mat applyExifOrientation(const cv::Mat& photo, const unsigned int orientation)
+{
+    cv::Mat oriented;
+
+    switch (orientation)
+    {
+    case 2:
+        cv::flip(photo, oriented, 1);
+        break;
+    case 3:
+        cv::rotate(photo, oriented, cv::ROTATE_180);
+        break;
+    case 4:
+        cv::flip(photo, oriented, 0);
+        break;
+    case 5:
+        cv::transpose(photo, oriented);
+        break;
+    case 6:
+        cv::rotate(photo, oriented, cv::ROTATE_90_CLOCKWISE);
+        break;
+    case 7:
+        cv::transpose(photo, oriented);
+        cv::flip(oriented, oriented, -1);
+        break;
+    case 8:
+        cv::rotate(photo, oriented, cv::ROTATE_90_COUNTERCLOCKWISE);
+        break;
+    default:
+        oriented = photo;
+        break;
+    }
+
+    return oriented;
+}
+
+struct ExifPreview
+{
+    cv::Mat preview;
+    cv::Size newSize;
+};
+
+/*
+ * Decode the preview embedded in the EXIF data so it can be resized instead of
+ * the full photo. The preview is only returned when it is at least as large as
+ * the resized photo and has the same aspect ratio.
+ */
+static std::optional<ExifPreview> decodeExifPreview(const std::vector<unsigned char>& encodedPhoto,
+    const PhotoOptions& photoOptions)
+{
+    // Previews padded to a different aspect ratio have black bars.
+    const double maxAspectRatioDifference = 0.02;
+
+    auto thumbnail = findExifThumbnail(encodedPhoto);
+    if (!thumbnail)
+    {
+        return std::nullopt;
+    }
+
+    cv::Mat encodedThumbnail(1, static_cast<int>(thumbnail->length), CV_8UC1,
+        const_cast<unsigned char*>(encodedPhoto.data() + thumbnail->offset));
+    cv::Mat preview = cv::imdecode(encodedThumbnail, cv::IMREAD_COLOR | cv::IMREAD_IGNORE_ORIENTATION);
+    if (preview.empty())
+    {
+        return std::nullopt;
+    }
+
+    const ImageDimensions& photoDimensions = thumbnail->photoDimensions;
+    double photoRatio = static_cast<double>(photoDimensions.width) / static_cast<double>(photoDimensions.height);
+    double previewRatio = static_cast<double>(preview.cols) / static_cast<double>(preview.rows);
+    if (std::abs(previewRatio - photoRatio) > photoRatio * maxAspectRatioDifference)
+    {
+        return std::nullopt;
+    }
+
+    // Orientations 5 through 8 swap the width and the height.
+    const bool swapsAxes = thumbnail->orientation >= 5;
+    cv::Size photoSize = swapsAxes ?
+        cv::Size(photoDimensions.height, photoDimensions.width) :
+        cv::Size(photoDimensions.width, photoDimensions.height);
+    cv::Size newSize = calculateResizedSize(photoSize, photoOptions);
+
+    preview = applyExifOrientation(preview, thumbnail->orientation);
+    if (newSize == photoSize || newSize.area() == 0 || newSize.width > preview.cols ||
+        newSize.height > preview.rows)
+    {
+        return std::nullopt;
+    }
+
+    return ExifPreview{preview, newSize};
+}
+
+// The EXIF APP1 segment is at most 64 KiB and comes before the frame header.
+static const std::uint64_t exifPreviewReadBytes = 128 * 1024;
+
+// Reads at most maxBytes from the start of the photo file.
+static std::vector<unsigned char> readPhotoFile(const std::string& inputName, std::uint64_t& fileSize,
+    std::uint64_t maxBytes = std::numeric_limits<std::uint64_t>::max())
+{
+    std::vector<unsigned char> encodedPhoto;
+    std::ifstream photoFile(inputName, std::ios::binary);
+    std::error_code ec;
+    fileSize = std::filesystem::file_size(inputName, ec);
+
+    if (photoFile && !ec)
+    {
+        encodedPhoto.resize(std::min(fileSize, maxBytes));
+        photoFile.read(reinterpret_cast<char*>(encodedPhoto.data()),
+            static_cast<std::streamsize>(encodedPhoto.size()));
+        // The file may have been truncated since its size was read.
+        encodedPhoto.resize(static_cast<std::size_t>(photoFile.gcount()));
     }
 
-    cv::Mat photo = cv::imread(photoFile.inputName);
-    if (photo.empty()) {
-        std::cerr << "Could not read photo " << photoFile.inputName << "!\n";
+    return encodedPhoto;
+}
+
+// Append the rest of a photo file of which only the start was read.
+static bool readRestOfPhotoFile(const std::string& inputName, std::uint64_t fileSize,
+    std::vector<unsigned char>& encodedPhoto)
+{
+    const std::size_t bytesAlreadyRead = encodedPhoto.size();
+    std::ifstream photoFile(inputName, std::ios::binary);
+
+    if (!photoFile.seekg(static_cast<std::streamoff>(bytesAlreadyRead)))
+    {
         return false;
     }
 
-    cv::Mat resized = resizeByUserSpecification(photo, photoOptions);
+    encodedPhoto.resize(fileSize);
+    photoFile.read(reinterpret_cast<char*>(encodedPhoto.data() + bytesAlreadyRead),
+        static_cast<std::streamsize>(fileSize - bytesAlreadyRead));
+    encodedPhoto.resize(bytesAlreadyRead + static_cast<std::size_t>(photoFile.gcount()));
+
+    return encodedPhoto.size() == fileSize;
+}
+
+/*
+ * Describe the resize the way resizeByUserSpecification() will perform it, so
+ * options that produce the same rendition share a cache entry. The output
+ * extension selects the encoder.
+ */
+static std::string makeRenditionSettings(const PhotoOptions& photoOptions, const std::string& outputName,
+    const std::vector<int>& encoderParameters)
+{
+    std::string settings("v1;");
+
+    if (photoOptions.maxWdith > 0 && photoOptions.maxHeight > 0)
+    {
+        settings += "exact:" + std::to_string(photoOptions.maxWdith) + "x" +
+            std::to_string(photoOptions.maxHeight);
+    }
+    else if (photoOptions.scaleFactor > 0)
+    {
+        settings += "scale:" + std::to_string(photoOptions.scaleFactor);
+    }
+    else if (photoOptions.maxWdith > 0)
+    {
+        settings += "width:" + std::to_string(photoOptions.maxWdith);
+    }
+    else if (photoOptions.maxHeight > 0)
+    {
+        settings += "height:" + std::to_string(photoOptions.maxHeight);
+    }
+
+    if (photoOptions.useExifThumbnail)
+    {
+        settings += ";exif-thumbnail";
+    }
+
+    settings += ";encoder:" + std::filesystem::path(outputName).extension().string();
+    for (auto parameter: encoderParameters)
+    {
+        settings += "," + std::to_string(parameter);
+    }
+    if (photoOptions.encoderOptions.maxBytes > 0)
+    {
+        settings += ";max-bytes:" + std::to_string(photoOptions.encoderOptions.maxBytes);
+    }
+
+    return settings;
+}
+
+static void recordSavedPhoto(ProgressMetrics& metrics, std::uint64_t inputBytes, const std::string& outputName)
+{
+    std::error_code ec;
+    std::uintmax_t bytesWritten = std::filesystem::file_size(outputName, ec);
+
+    if (!ec)
+    {
+        metrics.addSavedPhotoBytes(inputBytes, bytesWritten);
+    }
+}
+
+using ReadRemainder = std::function<bool(std::vector<unsigned char>&)>;
+
+/*
+ * The photo has already been read into memory, either from its own file or
+ * from an archive. When only the start of a file of inputBytes was read for
+ * the EXIF preview, readRemainder reads the rest if the whole photo has to be
+ * decoded.
+ */
+static bool resizeAndSaveEncodedPhoto(std::vector<unsigned char>& encodedPhoto, std::uint64_t inputBytes,
+    const ReadRemainder& readRemainder, const PhotoFile& photoFile, const PhotoOptions& photoOptions,
+    RenditionCache& renditionCache, ProgressMetrics& metrics, PackWriter* packWriter)
+{
+    const std::string inputName = photoFile.inputName();
+    const std::string outputName = photoFile.outputName();
+
+    auto stageStart = ProgressMetrics::clock::now();
+    auto stageDone = [&metrics, &stageStart](PhotoStage stage) {
+        auto stageEnd = ProgressMetrics::clock::now();
+        metrics.observeStage(stage, stageEnd - stageStart);
+        stageStart = stageEnd;
+    };
+
+    metrics.addBytesRead(encodedPhoto.size());
+
+    const std::vector<int> encoderParameters =
+        makeEncoderParameters(photoOptions.encoderOptions, outputName);
+
+    std::string cacheKey;
+    if (renditionCache.isEnabled() && !encodedPhoto.empty())
+    {
+        cacheKey = renditionCache.makeKey(encodedPhoto,
+            makeRenditionSettings(photoOptions, outputName, encoderParameters));
+        if (!cacheKey.empty() && !photoOptions.displayResized &&
+            renditionCache.materialize(cacheKey, outputName))
+        {
+            recordSavedPhoto(metrics, inputBytes, outputName);
+            return true;
+        }
+    }
+    stageStart = ProgressMetrics::clock::now();
+
+    cv::Mat resized;
+    if (photoOptions.useExifThumbnail && !encodedPhoto.empty())
+    {
+        // A rejected preview's decode time is counted with the photo's decode.
+        if (auto preview = decodeExifPreview(encodedPhoto, photoOptions))
+        {
+            stageDone(PhotoStage::Decode);
+            resized = resizePhoto(preview->preview, preview->newSize.width, preview->newSize.height);
+        }
+    }
+
+    if (resized.empty() && encodedPhoto.size() < inputBytes && readRemainder)
+    {
+        const std::size_t bytesAlreadyRead = encodedPhoto.size();
+        const auto readStart = ProgressMetrics::clock::now();
+        if (!readRemainder(encodedPhoto))
+        {
+            std::cerr << "Could not read photo " << inputName << "!\n";
+            return false;
+        }
+        metrics.addBytesRead(encodedPhoto.size() - bytesAlreadyRead);
+        // The read isn't part of the decode.
+        stageStart += ProgressMetrics::clock::now() - readStart;
+    }
+
+    if (resized.empty())
+    {
+        cv::Mat photo;
+        if (!encodedPhoto.empty())
+        {
+            photo = cv::imdecode(encodedPhoto, cv::IMREAD_COLOR);
+            // Prevent memory leak
+            std::vector<unsigned char>().swap(encodedPhoto);
+        }
+        stageDone(PhotoStage::Decode);
+
+        if (photo.empty()) {
+            std::cerr << "Could not read photo " << inputName << "!\n";
+            return false;
+        }
+
+        resized = resizeByUserSpecification(photo, photoOptions);
+    }
+    stageDone(PhotoStage::Resize);
 
     if (photoOptions.displayResized)
     {
         cv::imshow("Resized Photo", resized);
         cv::waitKey(0);
+        stageStart = ProgressMetrics::clock::now();
     }
 
-    return saveResizedPhoto(resized, photoFile.outputName);
+    if (packWriter)
+    {
+        std::uint64_t bytesPacked = savePackedPhoto(resized, photoFile, encoderParameters,
+            photoOptions.encoderOptions, metrics, *packWriter);
+        stageDone(PhotoStage::Write);
+        if (bytesPacked == 0)
+        {
+            return false;
+        }
+
+        metrics.addSavedPhotoBytes(inputBytes, bytesPacked);
+        return true;
+    }
+
+    bool saved = saveResizedPhoto(resized, outputName, encoderParameters, photoOptions.encoderOptions, metrics);
+    stageDone(PhotoStage::Write);
+
+    if (saved)
+    {
+        recordSavedPhoto(metrics, inputBytes, outputName);
+        if (!cacheKey.empty())
+        {
+            renditionCache.insert(cacheKey, outputName);
+        }
+    }
+
+    return saved;
+}
+
+static bool resizeAndSavePhoto(const PhotoFile& photoFile, const PhotoOptions& photoOptions,
+    RenditionCache& renditionCache, ProgressMetrics& metrics, PackWriter* packWriter)
+{
+    // Possibly file already exists and user did not specify --overwrite
+    if (!photoFile.hasOutput())
+    {
+        return false;
+    }
+
+    /*
+     * The EXIF preview and the frame header are near the start of the file,
+     * the rest is only read if the preview can't be used. The cache key is a
+     * hash of the whole photo so the cache needs all of it.
+     */
+    const std::string inputName = photoFile.inputName();
+    const bool readPreviewOnly = photoOptions.useExifThumbnail && !renditionCache.isEnabled();
+    std::uint64_t fileSize = 0;
+
+    auto readStart = ProgressMetrics::clock::now();
+    std::vector<unsigned char> encodedPhoto = readPreviewOnly ?
+        readPhotoFile(inputName, fileSize, exifPreviewReadBytes) : readPhotoFile(inputName, fileSize);
+    auto readTime = ProgressMetrics::clock::now() - readStart;
+
+    ReadRemainder readRemainder;
+    if (readPreviewOnly)
+    {
+        readRemainder = [&](std::vector<unsigned char>& photo) {
+            auto remainderStart = ProgressMetrics::clock::now();
+            bool read = readRestOfPhotoFile(inputName, fileSize, photo);
+            readTime += ProgressMetrics::clock::now() - remainderStart;
+            return read;
+        };
+    }
+
+    bool resized = resizeAndSaveEncodedPhoto(encodedPhoto, fileSize, readRemainder, photoFile, photoOptions,
+        renditionCache, metrics, packWriter);
+    metrics.observeStage(PhotoStage::Read, readTime);
+
+    return resized;
+}
+
+/*
+ * The photos in the order they are resized. Directory order without probing
+ * needs no job list, the positions are the photo indexes. Photos of at least
+ * the intra image threshold are resized one at a time with every thread given
+ * to OpenCV, the scheduled order is kept within both parts.
+ */
+class PhotoSchedule
+{
+public:
+    PhotoSchedule(const PhotoFileList& photoList, const ExecutionOptions& executionOptions,
+        bool resizeInParallel)
+        : photoCount{photoList.size()}
+    {
+        if (resizeInParallel)
+        {
+            intraImagePixels = static_cast<std::uint64_t>(executionOptions.intraImageMegapixels) * 1000000;
+        }
+
+        if (executionOptions.jobOrder != JobOrder::Directory || intraImagePixels > 0)
+        {
+            jobs = schedulePhotoJobs(photoList, executionOptions.jobOrder, intraImagePixels > 0);
+        }
+    }
+
+    std::size_t size() const noexcept { return photoCount; }
+    std::size_t photoIndex(std::size_t position) const noexcept
+    {
+        return jobs.empty() ? position : jobs[position].photoIndex;
+    }
+    bool isIntraImage(std::size_t position) const noexcept
+    {
+        return intraImagePixels > 0 && jobs[position].key >= intraImagePixels;
+    }
+
+private:
+    std::size_t photoCount;
+    std::uint64_t intraImagePixels = 0;
+    std::vector<PhotoJob> jobs;
+};
+
+// --threads limits the number of threads used, the default is one per CPU.
+static unsigned int countAvailableThreads(const ExecutionOptions& executionOptions)
+{
+    if (executionOptions.workerThreads > 0)
+    {
+        return executionOptions.workerThreads;
+    }
+
+    return std::max(std::thread::hardware_concurrency(), 1U);
+}
+
+static unsigned int countWorkerThreads(const PhotoOptions& photoOptions,
+    const ExecutionOptions& executionOptions)
+{
+    // Only one photo can be displayed at a time.
+    if (photoOptions.displayResized)
+    {
+        return 1;
+    }
+
+    return countAvailableThreads(executionOptions);
+}
+
+class PhotoListResizer
+{
+public:
+    PhotoListResizer(const PhotoOptions& photoOptions, const PhotoFileList& photoList,
+        RenditionCache& renditionCache, ProgressMetrics& metrics, PackWriter* packWriter)
+        : photoOptions{photoOptions}, photoList{photoList}, renditionCache{renditionCache}, metrics{metrics},
+        packWriter{packWriter}
+    {
+    }
+
+    /*
+     * An exception from OpenCV fails only the photo that caused it, it must
+     * never escape a worker thread.
+     */
+    void resizePhoto(std::size_t photoIndex)
+    {
+        const PhotoFile photo = photoList[photoIndex];
+
+        try
+        {
+            recordResult(photo, resizeAndSavePhoto(photo, photoOptions, renditionCache, metrics, packWriter));
+        }
+        catch (const std::exception& error)
+        {
+            recordFailure(photo, error);
+        }
+    }
+
+    void resizeEncodedPhoto(const PhotoFile& photo, std::vector<unsigned char>& encodedPhoto)
+    {
+        try
+        {
+            recordResult(photo, resizeAndSaveEncodedPhoto(encodedPhoto, encodedPhoto.size(), {}, photo,
+                photoOptions, renditionCache, metrics, packWriter));
+        }
+        catch (const std::exception& error)
+        {
+            recordFailure(photo, error);
+        }
+    }
+
+    void skipPhoto()
+    {
+        metrics.photoSkipped();
+    }
+
+    // The intra image photos are left for resizing one at a time.
+    void resizeInParallel(const PhotoSchedule& schedule, unsigned int workerCount,
+        const std::vector<int>& workerCpus)
+    {
+        std::atomic<std::size_t> nextPhoto = 0;
+        auto worker = [this, &schedule, &nextPhoto, &workerCpus](unsigned int workerNumber) {
+            if (!workerCpus.empty())
+            {
+                pinCurrentThreadToCpu(workerCpus[workerNumber % workerCpus.size()]);
+            }
+
+            for (std::size_t next = nextPhoto++; next < schedule.size(); next = nextPhoto++)
+            {
+                if (!schedule.isIntraImage(next))
+                {
+                    resizePhoto(schedule.photoIndex(next));
+                }
+            }
+        };
+
+        std::vector<std::jthread> workers;
+        for (unsigned int workerNumber = 0; workerNumber < workerCount; ++workerNumber)
+        {
+            workers.emplace_back(worker, workerNumber);
+        }
+    }
+
+    PhotoFileList resizeArchivePhotos(FileOptions& fileOptions, unsigned int workerCount,
+        const std::vector<int>& workerCpus);
+
+    std::size_t resizedPhotos() const noexcept { return resizedCount.load(); }
+
+private:
+    void recordResult(const PhotoFile& photo, bool resized)
+    {
+        if (resized)
+        {
+            resizedCount.fetch_add(1, std::memory_order_relaxed);
+            metrics.photoProcessed();
+        }
+        else if (!photo.hasOutput())
+        {
+            metrics.photoSkipped();
+        }
+        else
+        {
+            metrics.photoFailed();
+        }
+    }
+
+    void recordFailure(const PhotoFile& photo, const std::exception& error)
+    {
+        std::cerr << "Could not resize photo " << photo.inputName() << ": " << error.what() << "\n";
+        metrics.photoFailed();
+    }
+
+    const PhotoOptions& photoOptions;
+    const PhotoFileList& photoList;
+    RenditionCache& renditionCache;
+    ProgressMetrics& metrics;
+    PackWriter* packWriter;
+    std::atomic<std::size_t> resizedCount = 0;
+};
+
+// The photo owns its names because the list grows while it waits to be resized.
+struct ArchivePhoto
+{
+    explicit ArchivePhoto(const PhotoFile& photo)
+        : inputDirectory{photo.inputDirectory()}, inputFileName{photo.inputFileName()},
+        outputDirectory{photo.outputDirectory()}, outputFileName{photo.outputFileName()}
+    {
+    }
+
+    PhotoFile photo() const { return PhotoFile(inputDirectory, inputFileName, outputDirectory, outputFileName); }
+
+    std::string inputDirectory;
+    std::string inputFileName;
+    std::string outputDirectory;
+    std::string outputFileName;
+    std::vector<unsigned char> encodedPhoto;
+};
+
+/*
+ * This thread builds the photo list from the archive and reads each photo as
+ * it is listed, in one sequential pass, and hands the photos to the worker
+ * threads through a bounded queue, so only a few photos are held in memory at
+ * once.
+ */
+PhotoFileList PhotoListResizer::resizeArchivePhotos(FileOptions& fileOptions, unsigned int workerCount,
+    const std::vector<int>& workerCpus)
+{
+    const std::size_t maxQueuedPhotos = 2 * static_cast<std::size_t>(workerCount);
+    std::deque<ArchivePhoto> queuedPhotos;
+    std::mutex queueMutex;
+    std::condition_variable photoQueued;
+    std::condition_variable photoTaken;
+    bool archiveFinished = false;
+
+    auto worker = [&, this](unsigned int workerNumber) {
+        if (!workerCpus.empty())
+        {
+            pinCurrentThreadToCpu(workerCpus[workerNumber % workerCpus.size()]);
+        }
+
+        while (true)
+        {
+            std::unique_lock<std::mutex> queueLock(queueMutex);
+            photoQueued.wait(queueLock, [&] { return !queuedPhotos.empty() || archiveFinished; });
+            if (queuedPhotos.empty())
+            {
+                return;
+            }
+
+            ArchivePhoto photo = std::move(queuedPhotos.front());
+            queuedPhotos.pop_front();
+            queueLock.unlock();
+            photoTaken.notify_one();
+
+            resizeEncodedPhoto(photo.photo(), photo.encodedPhoto);
+        }
+    };
+
+    std::vector<std::jthread> workers;
+    for (unsigned int workerNumber = 0; workerCount > 1 && workerNumber < workerCount; ++workerNumber)
+    {
+        workers.emplace_back(worker, workerNumber);
+    }
+
+    /*
+     * Destroyed before the workers are joined, so they are released even when
+     * reading the archive throws.
+     */
+    struct QueueCloser
+    {
+        std::mutex& queueMutex;
+        bool& archiveFinished;
+        std::condition_variable& photoQueued;
+
+        ~QueueCloser()
+        {
+            {
+                std::lock_guard<std::mutex> queueLock(queueMutex);
+                archiveFinished = true;
+            }
+            photoQueued.notify_all();
+        }
+    } queueCloser{queueMutex, archiveFinished, photoQueued};
+
+    auto readArchivePhoto = [&, this](PhotoArchive& archive, const PhotoFile& photo) {
+        metrics.photoFound();
+        if (!photo.hasOutput())
+        {
+            skipPhoto();
+            return;
+        }
+
+        auto readStart = ProgressMetrics::clock::now();
+        ArchivePhoto archivePhoto(photo);
+        const bool memberRead = archive.readMember(archivePhoto.encodedPhoto);
+        metrics.observeStage(PhotoStage::Read, ProgressMetrics::clock::now() - readStart);
+        if (!memberRead)
+        {
+            std::cerr << "Could not read photo " << photo.inputName() << "!\n";
+            metrics.photoFailed();
+            return;
+        }
+
+        if (workers.empty())
+        {
+            resizeEncodedPhoto(photo, archivePhoto.encodedPhoto);
+            return;
+        }
+
+        std::unique_lock<std::mutex> queueLock(queueMutex);
+        photoTaken.wait(queueLock, [&] { return queuedPhotos.size() < maxQueuedPhotos; });
+        queuedPhotos.push_back(std::move(archivePhoto));
+        queueLock.unlock();
+        photoQueued.notify_one();
+    };
+
+    return buildPhotoInputAndOutputList(fileOptions, readArchivePhoto);
 }
 
-std::size_t resizeAllPhotosInList(const PhotoOptions& photoOptions, const PhotoFileList& photoList)
+/*
+ * Photos smaller than the intra image threshold are resized one per worker
+ * thread with OpenCV's own thread pool limited to a single thread. The larger
+ * photos are then resized one at a time with every thread given to OpenCV, so
+ * the two levels of parallelism never oversubscribe the CPUs.
+ */
+std::size_t resizeAllPhotosInList(const PhotoOptions& photoOptions, const ExecutionOptions& executionOptions,
+    const PhotoFileList& photoList, RenditionCache& renditionCache, ProgressMetrics& metrics,
+    PackWriter* packWriter)
 {
-    std::size_t resizedCount = 0;
+    PhotoListResizer listResizer(photoOptions, photoList, renditionCache, metrics, packWriter);
+    const unsigned int workerCount = countWorkerThreads(photoOptions, executionOptions);
+    const bool resizeInParallel = workerCount > 1 && photoList.size() > 1;
 
-    for (auto photo: photoList)
+    // The photo headers are only read when the photos are partitioned by size.
+    const PhotoSchedule schedule(photoList, executionOptions, resizeInParallel);
+    const int openCVThreads = cv::getNumThreads();
+
+    // One photo at a time, every available thread goes to OpenCV.
+    if (!resizeInParallel)
     {
-        if (resizeAndSavePhoto(photo, photoOptions))
+        cv::setNumThreads(static_cast<int>(countAvailableThreads(executionOptions)));
+        for (std::size_t position = 0; position < schedule.size(); ++position)
         {
-            ++resizedCount;
+            listResizer.resizePhoto(schedule.photoIndex(position));
         }
+        cv::setNumThreads(openCVThreads);
+
+        return listResizer.resizedPhotos();
     }
 
-    return resizedCount;
+    std::vector<int> workerCpus = executionOptions.pinWorkers ? findWorkerCpus() : std::vector<int>();
+
+    cv::setNumThreads(1);
+    listResizer.resizeInParallel(schedule, workerCount, workerCpus);
+
+    cv::setNumThreads(static_cast<int>(workerCount));
+    for (std::size_t position = 0; position < schedule.size(); ++position)
+    {
+        if (schedule.isIntraImage(position))
+        {
+            listResizer.resizePhoto(schedule.photoIndex(position));
+        }
+    }
+
+    cv::setNumThreads(openCVThreads);
+
+    return listResizer.resizedPhotos();
 }
 
+std::size_t resizeAllPhotosInArchive(const PhotoOptions& photoOptions, const ExecutionOptions& executionOptions,
+    FileOptions& fileOptions, PhotoFileList& photoList, RenditionCache& renditionCache, ProgressMetrics& metrics,
+    PackWriter* packWriter)
+{
+    PhotoListResizer listResizer(photoOptions, photoList, renditionCache, metrics, packWriter);
+    const unsigned int workerCount = countWorkerThreads(photoOptions, executionOptions);
+    const bool resizeInParallel = workerCount > 1;
+    std::vector<int> workerCpus = executionOptions.pinWorkers ? findWorkerCpus() : std::vector<int>();
+    const int openCVThreads = cv::getNumThreads();
+
+    cv::setNumThreads(resizeInParallel ? 1 : static_cast<int>(countAvailableThreads(executionOptions)));
+    photoList = listResizer.resizeArchivePhotos(fileOptions, resizeInParallel ? workerCount : 1, workerCpus);
+    cv::setNumThreads(openCVThreads);
+
+    return listResizer.resizedPhotos();
+}
@@ -1,9 +1,24 @@
 #ifndef PHOTORESIZER_H_
 #define PHOTORESIZER_H_
 
+#include "ExecutionOptions.h"
+#include "FileOptions.h"
+#include "PackFile.h"
 #include "PhotoOptions.h"
 #include "PhotoFileList.h"
+#include "ProgressMetrics.h"
+#include "RenditionCache.h"
 
-std::size_t resizeAllPhotosInList(const PhotoOptions& ctrlValues, const PhotoFileList& photoList);
+std::size_t resizeAllPhotosInList(const PhotoOptions& ctrlValues, const ExecutionOptions& executionOptions,
+    const PhotoFileList& photoList, RenditionCache& renditionCache, ProgressMetrics& metrics,
+    PackWriter* packWriter);
+
+/*
+ * The photo list of an archive is built while its photos are resized, so the
+ * archive is only read once. photoList is set to the photos found.
+ */
+std::size_t resizeAllPhotosInArchive(const PhotoOptions& photoOptions, const ExecutionOptions& executionOptions,
+    FileOptions& fileOptions, PhotoFileList& photoList, RenditionCache& renditionCache, ProgressMetrics& metrics,
+    PackWriter* packWriter);
 
 #endif // PHOTORESIZER_H_
@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <locale>
+#include <mutex>
+#include "ProgressMetrics.h"
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+static const auto progressLineInterval = std::chrono::seconds(1);
+
+static const std::array<std::string_view, static_cast<std::size_t>(PhotoStage::StageCount)> stageNames =
+    {"read", "decode", "resize", "write"};
+
+static const double bytesPerMegabyte = 1024.0 * 1024.0;
+
+void LatencyHistogram::observe(std::chrono::steady_clock::duration latency) noexcept
+{
+    const double seconds = std::chrono::duration<double>(latency).count();
+    std::size_t bucket = 0;
+
+    while (bucket < bucketBounds.size() && seconds > bucketBounds[bucket])
+    {
+        ++bucket;
+    }
+
+    buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+    sumNanoseconds.fetch_add(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count()),
+        std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Prometheus histogram buckets are cumulative.
+void LatencyHistogram::writePrometheus(std::ostream& out, std::string_view name,
+    std::string_view stage) const
+{
+    std::uint64_t cumulative = 0;
+
+    for (std::size_t bucket = 0; bucket < bucketBounds.size(); ++bucket)
+    {
+        cumulative += buckets[bucket].load(std::memory_order_relaxed);
+        out << name << "_bucket{stage=\"" << stage << "\",le=\"" << bucketBounds[bucket] << "\"} "
+            << cumulative << "\n";
+    }
+    cumulative += buckets[bucketBounds.size()].load(std::memory_order_relaxed);
+    out << name << "_bucket{stage=\"" << stage << "\",le=\"+Inf\"} " << cumulative << "\n";
+    out << name << "_sum{stage=\"" << stage << "\"} "
+        << static_cast<double>(sumNanoseconds.load(std::memory_order_relaxed)) / 1e9 << "\n";
+    out << name << "_count{stage=\"" << stage << "\"} " << count.load(std::memory_order_relaxed) << "\n";
+}
+
+ProgressMetrics::ProgressMetrics(std::size_t totalPhotos, const ExecutionOptions& executionOptions)
+    : photoCount{totalPhotos}, options{executionOptions}
+{
+    if (options.showProgress || !options.metricsFile.empty())
+    {
+        reporter = std::jthread([this](std::stop_token stopToken) { reportPeriodically(stopToken); });
+    }
+}
+
+ProgressMetrics::~ProgressMetrics()
+{
+    finish();
+}
+
+void ProgressMetrics::observeStage(PhotoStage stage, clock::duration latency) noexcept
+{
+    stageLatency[static_cast<std::size_t>(stage)].observe(latency);
+}
+
+void ProgressMetrics::addTrialEncodes(unsigned int photoTrialEncodes) noexcept
+{
+    const std::size_t bucket = std::min<std::size_t>(photoTrialEncodes, trialEncodePhotos.size() - 1);
+
+    trialEncodePhotos[bucket].fetch_add(1, std::memory_order_relaxed);
+    trialEncodes.fetch_add(photoTrialEncodes, std::memory_order_relaxed);
+}
+
+// The input bytes are only counted for photos that were saved.
+void ProgressMetrics::addSavedPhotoBytes(std::uint64_t inputBytes, std::uint64_t outputBytes) noexcept
+{
+    savedPhotoInputBytes.fetch_add(inputBytes, std::memory_order_relaxed);
+    bytesWritten.fetch_add(outputBytes, std::memory_order_relaxed);
+}
+
+std::string ProgressMetrics::bytesSavedReport() const
+{
+    const std::uint64_t inputBytes = savedPhotoInputBytes.load();
+    const std::uint64_t outputBytes = bytesWritten.load();
+    const bool smaller = outputBytes <= inputBytes;
+    const std::uint64_t difference = smaller ? inputBytes - outputBytes : outputBytes - inputBytes;
+
+    std::string report(std::to_string(outputBytes) + " bytes written, " + std::to_string(difference) +
+        " bytes " + (smaller ? "saved" : "more") + " than the " + std::to_string(inputBytes) + " input bytes");
+    if (inputBytes > 0)
+    {
+        report += " (" + std::to_string(difference * 100 / inputBytes) + "%)";
+    }
+
+    return report + "\n";
+}
+
+// Empty unless --max-bytes searched for a quality.
+std::string ProgressMetrics::trialEncodeReport() const
+{
+    std::uint64_t photos = 0;
+    for (const auto& bucket: trialEncodePhotos)
+    {
+        photos += bucket.load();
+    }
+    if (photos == 0)
+    {
+        return "";
+    }
+
+    const std::uint64_t encodes = trialEncodes.load();
+    const std::uint64_t tenthsPerPhoto = (encodes * 10 + photos / 2) / photos;
+    std::string report("Byte budget: " + std::to_string(encodes) + " trial encodes for " +
+        std::to_string(photos) + " photos, " + std::to_string(tenthsPerPhoto / 10) + "." +
+        std::to_string(tenthsPerPhoto % 10) + " per photo\n");
+
+    for (std::size_t bucket = 1; bucket < trialEncodePhotos.size(); ++bucket)
+    {
+        const std::uint64_t bucketPhotos = trialEncodePhotos[bucket].load();
+        if (bucketPhotos > 0)
+        {
+            const bool last = bucket == trialEncodePhotos.size() - 1;
+            report += "    " + std::to_string(bucket) + (last ? " or more" : "") + " trial encode" +
+                (bucket == 1 ? "" : "s") + ": " + std::to_string(bucketPhotos) + " photos\n";
+        }
+    }
+
+    return report;
+}
+
+void ProgressMetrics::finish()
+{
+    if (finished || !reporter.joinable())
+    {
+        return;
+    }
+
+    finished = true;
+    reporter.request_stop();
+    reporter.join();
+
+    if (options.showProgress)
+    {
+        printProgressLine(true);
+    }
+    if (!options.metricsFile.empty())
+    {
+        writeMetricsFile();
+    }
+}
+
+void ProgressMetrics::reportPeriodically(std::stop_token stopToken)
+{
+    std::mutex sleepMutex;
+    std::condition_variable_any sleeper;
+    const auto metricsInterval = std::chrono::seconds(std::max(options.metricsIntervalSeconds, 1U));
+    auto nextMetricsWrite = clock::now();
+
+    std::unique_lock<std::mutex> sleepLock(sleepMutex);
+    while (!stopToken.stop_requested())
+    {
+        if (options.showProgress)
+        {
+            printProgressLine(false);
+        }
+
+        if (!options.metricsFile.empty() && clock::now() >= nextMetricsWrite)
+        {
+            writeMetricsFile();
+            nextMetricsWrite += metricsInterval;
+        }
+
+        sleeper.wait_for(sleepLock, stopToken, progressLineInterval, [] { return false; });
+    }
+}
+
+void ProgressMetrics::printProgressLine(bool lastLine) const
+{
+    const double elapsed = std::chrono::duration<double>(clock::now() - startTime).count();
+    const std::uint64_t done = processed.load(std::memory_order_relaxed) +
+        failed.load(std::memory_order_relaxed) + skipped.load(std::memory_order_relaxed);
+    const std::uint64_t total = photoCount.load(std::memory_order_relaxed);
+    const double photosPerSecond = elapsed > 0.0 ? done / elapsed : 0.0;
+    const double megabytesPerSecond = elapsed > 0.0 ?
+        bytesRead.load(std::memory_order_relaxed) / bytesPerMegabyte / elapsed : 0.0;
+
+    std::ostringstream line;
+    line.imbue(std::locale::classic());
+    line << std::fixed << std::setprecision(1)
+        << "\r" << done << " of " << total << " photos, "
+        << photosPerSecond << " photos/s, " << megabytesPerSecond << " MB/s";
+
+    if (photosPerSecond > 0.0 && done < total && !photoCountGrowing.load(std::memory_order_relaxed))
+    {
+        const auto eta = static_cast<std::uint64_t>((total - done) / photosPerSecond);
+        line << ", ETA " << eta / 3600 << ":" << std::setfill('0') << std::setw(2) << (eta / 60) % 60
+            << ":" << std::setw(2) << eta % 60;
+    }
+
+    // Pad to overwrite the tail of a longer previous line.
+    line << "        " << (lastLine ? "\n" : "");
+
+    std::cerr << line.str() << std::flush;
+}
+
+/*
+ * Write to a temporary file and rename it so the scraper never reads a
+ * partially written file.
+ */
+void ProgressMetrics::writeMetricsFile() const
+{
+    const std::string tempName = options.metricsFile + ".tmp";
+    std::ofstream metrics(tempName, std::ios::trunc);
+    if (!metrics)
+    {
+        return;
+    }
+
+    metrics.imbue(std::locale::classic());
+
+    auto writeCounter = [&metrics](std::string_view name, std::string_view help, std::uint64_t value) {
+        metrics << "# HELP " << name << " " << help << "\n"
+            << "# TYPE " << name << " counter\n"
+            << name << " " << value << "\n";
+    };
+
+    writeCounter("photoresize_photos_processed_total", "Photos resized and saved.",
+        processed.load(std::memory_order_relaxed));
+    writeCounter("photoresize_photos_failed_total", "Photos that could not be read or saved.",
+        failed.load(std::memory_order_relaxed));
+    writeCounter("photoresize_photos_skipped_total", "Photos skipped because the output already exists.",
+        skipped.load(std::memory_order_relaxed));
+    writeCounter("photoresize_bytes_read_total", "Bytes of input photos read.",
+        bytesRead.load(std::memory_order_relaxed));
+    writeCounter("photoresize_bytes_written_total", "Bytes of resized photos written.",
+        bytesWritten.load(std::memory_order_relaxed));
+    writeCounter("photoresize_trial_encodes_total", "Encodes used to search for the quality that fits --max-bytes.",
+        trialEncodes.load(std::memory_order_relaxed));
+
+    metrics << "# HELP photoresize_photos Photos in this run.\n"
+        << "# TYPE photoresize_photos gauge\n"
+        << "photoresize_photos " << photoCount.load(std::memory_order_relaxed) << "\n";
+
+    metrics << "# HELP photoresize_last_update_timestamp_seconds When this file was last written.\n"
+        << "# TYPE photoresize_last_update_timestamp_seconds gauge\n"
+        << "photoresize_last_update_timestamp_seconds "
+        << std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count() << "\n";
+
+    const std::string_view histogramName = "photoresize_stage_duration_seconds";
+    metrics << "# HELP " << histogramName << " Time spent in each stage of resizing a photo.\n"
+        << "# TYPE " << histogramName << " histogram\n";
+    for (std::size_t stage = 0; stage < stageLatency.size(); ++stage)
+    {
+        stageLatency[stage].writePrometheus(metrics, histogramName, stageNames[stage]);
+    }
+
+    metrics.close();
+
+    std::error_code ec;
+    std::filesystem::rename(tempName, options.metricsFile, ec);
+    if (ec)
+    {
+        std::filesystem::remove(tempName, ec);
+    }
+}
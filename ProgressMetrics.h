@@ -0,0 +1,98 @@
+#ifndef PROGRESSMETRICS_H_
+#define PROGRESSMETRICS_H_
+
+/*
+ * Live progress and throughput metrics for long running jobs. The per photo
+ * updates are relaxed atomic increments, a reporter thread periodically
+ * prints a progress line on stderr and rewrites a Prometheus text format
+ * file that a node exporter textfile collector can scrape.
+ */
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "ExecutionOptions.h"
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+enum class PhotoStage
+{
+    Read,
+    Decode,
+    Resize,
+    Write,
+    StageCount
+};
+
+class LatencyHistogram
+{
+public:
+    static constexpr std::array<double, 12> bucketBounds =
+        {0.001, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0};
+
+    void observe(std::chrono::steady_clock::duration latency) noexcept;
+    void writePrometheus(std::ostream& out, std::string_view name, std::string_view stage) const;
+
+private:
+    // The last bucket counts observations above every bound.
+    std::array<std::atomic<std::uint64_t>, bucketBounds.size() + 1> buckets{};
+    std::atomic<std::uint64_t> sumNanoseconds = 0;
+    std::atomic<std::uint64_t> count = 0;
+};
+
+class ProgressMetrics
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    ProgressMetrics(std::size_t totalPhotos, const ExecutionOptions& executionOptions);
+    ~ProgressMetrics();
+
+    void photoProcessed() noexcept { processed.fetch_add(1, std::memory_order_relaxed); }
+    void photoFailed() noexcept { failed.fetch_add(1, std::memory_order_relaxed); }
+    void photoSkipped() noexcept { skipped.fetch_add(1, std::memory_order_relaxed); }
+    // Photos listed while they are resized are counted as they are found, without an ETA.
+    void photoFound() noexcept
+    {
+        photoCount.fetch_add(1, std::memory_order_relaxed);
+        photoCountGrowing.store(true, std::memory_order_relaxed);
+    }
+    void addBytesRead(std::uint64_t bytes) noexcept { bytesRead.fetch_add(bytes, std::memory_order_relaxed); }
+    void addSavedPhotoBytes(std::uint64_t inputBytes, std::uint64_t outputBytes) noexcept;
+    void observeStage(PhotoStage stage, clock::duration latency) noexcept;
+    void addTrialEncodes(unsigned int trialEncodes) noexcept;
+    std::uint64_t totalBytesRead() const noexcept { return bytesRead.load(); }
+    std::uint64_t totalBytesWritten() const noexcept { return bytesWritten.load(); }
+    std::string bytesSavedReport() const;
+    std::string trialEncodeReport() const;
+
+    // Stop the reporter thread and publish the final values.
+    void finish();
+
+private:
+    void reportPeriodically(std::stop_token stopToken);
+    void printProgressLine(bool lastLine) const;
+    void writeMetricsFile() const;
+
+    std::atomic<std::uint64_t> photoCount;
+    std::atomic<bool> photoCountGrowing = false;
+    const ExecutionOptions options;
+    const clock::time_point startTime = clock::now();
+    std::atomic<std::uint64_t> processed = 0;
+    std::atomic<std::uint64_t> failed = 0;
+    std::atomic<std::uint64_t> skipped = 0;
+    std::atomic<std::uint64_t> bytesRead = 0;
+    std::atomic<std::uint64_t> bytesWritten = 0;
+    std::atomic<std::uint64_t> savedPhotoInputBytes = 0;
+    std::array<LatencyHistogram, static_cast<std::size_t>(PhotoStage::StageCount)> stageLatency;
+    // Photos by the number of trial encodes --max-bytes needed, the last counts any more.
+    std::array<std::atomic<std::uint64_t>, 17> trialEncodePhotos{};
+    std::atomic<std::uint64_t> trialEncodes = 0;
+    bool finished = false;
+    std::jthread reporter;
+};
+
+#endif // PROGRESSMETRICS_H_
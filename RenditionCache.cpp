@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <fcntl.h>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <linux/fs.h>
+#include <openssl/evp.h>
+#include "RenditionCache.h"
+#include <sstream>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <tuple>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+static const std::string entryExtension = ".rendition";
+static const std::string tempFilePrefix = ".tmp-";
+
+// Temporary files older than this were left behind by a process that died.
+static const auto abandonedTempFileAge = std::chrono::hours(1);
+
+// Other processes sharing the directory also add entries, rescan it this often.
+static const auto cacheRescanInterval = std::chrono::seconds(30);
+
+// Evict down to this percentage of the maximum so eviction isn't run on every insert.
+static const std::uintmax_t evictionLowWaterPercent = 90;
+
+struct CacheEntry
+{
+    fs::path path;
+    std::tuple<time_t, long> lastUsed;
+    std::uintmax_t size;
+};
+
+/*
+ * SHA-256, a cache shared by many jobs must never serve one photo's rendition
+ * for another.
+ */
+static std::string hashBytes(const unsigned char* bytes, std::size_t length)
+{
+    std::array<unsigned char, EVP_MAX_MD_SIZE> digest;
+    unsigned int digestLength = 0;
+
+    if (!EVP_Digest(bytes, length, digest.data(), &digestLength, EVP_sha256(), nullptr))
+    {
+        return "";
+    }
+
+    std::ostringstream hash;
+    hash << std::hex << std::setfill('0');
+    for (unsigned int i = 0; i < digestLength; ++i)
+    {
+        hash << std::setw(2) << static_cast<unsigned int>(digest[i]);
+    }
+
+    return hash.str();
+}
+
+RenditionCache::RenditionCache(const std::string& cacheDirectory, std::uintmax_t maxCacheBytes,
+    bool hardlinkOutputs)
+    : maxBytes{maxCacheBytes}, linkOutputs{hardlinkOutputs}
+{
+    if (cacheDirectory.empty())
+    {
+        return;
+    }
+
+    std::error_code ec;
+    cacheDir = fs::absolute(cacheDirectory, ec);
+    fs::create_directories(cacheDir, ec);
+    if (ec || !fs::is_directory(cacheDir))
+    {
+        std::cerr << "The rendition cache directory " << cacheDirectory <<
+            " can't be created, caching is disabled!\n";
+        return;
+    }
+
+    enabled = true;
+    cachedBytes = evictLeastRecentlyUsed(maxBytes, maxBytes);
+}
+
+// An empty key disables caching of the photo.
+std::string RenditionCache::makeKey(const std::vector<unsigned char>& inputPhoto,
+    const std::string& settings) const
+{
+    const std::string photoHash = hashBytes(inputPhoto.data(), inputPhoto.size());
+    const std::string settingsHash = hashBytes(reinterpret_cast<const unsigned char*>(settings.data()),
+        settings.size());
+    if (photoHash.empty() || settingsHash.empty())
+    {
+        return "";
+    }
+
+    return photoHash + "-" + settingsHash;
+}
+
+fs::path RenditionCache::entryPath(const std::string& key) const
+{
+    return cacheDir / (key + entryExtension);
+}
+
+/*
+ * A reflink shares the data blocks of the entry the way a hardlink would, but
+ * the output is a separate file. File systems without reflinks get a copy.
+ */
+static bool copyEntry(const fs::path& entry, const std::string& outputName)
+{
+    int entryFd = ::open(entry.c_str(), O_RDONLY | O_CLOEXEC);
+    if (entryFd < 0)
+    {
+        return false;
+    }
+
+    int outputFd = ::open(outputName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    const bool cloned = outputFd >= 0 && ::ioctl(outputFd, FICLONE, entryFd) == 0;
+    if (outputFd >= 0)
+    {
+        ::close(outputFd);
+    }
+    ::close(entryFd);
+
+    if (cloned)
+    {
+        return true;
+    }
+
+    std::error_code ec;
+    fs::copy_file(entry, outputName, fs::copy_options::overwrite_existing, ec);
+
+    return !ec;
+}
+
+/*
+ * Produce the output file from the cache without decoding anything. The
+ * existing output is removed first so an older hardlink into the cache is
+ * never written through.
+ */
+bool RenditionCache::materialize(const std::string& key, const std::string& outputName)
+{
+    fs::path entry = entryPath(key);
+    std::error_code ec;
+
+    if (!fs::exists(entry, ec))
+    {
+        ++missCount;
+        return false;
+    }
+
+    fs::remove(outputName, ec);
+    bool materialized = false;
+    if (linkOutputs)
+    {
+        // Fails on a different file system than the cache, or when the entry was just evicted.
+        fs::create_hard_link(entry, outputName, ec);
+        materialized = !ec;
+    }
+
+    if (!materialized && !copyEntry(entry, outputName))
+    {
+        ++missCount;
+        return false;
+    }
+
+    /*
+     * The access time of an entry records when it was last used. Setting it
+     * leaves the modification time of hardlinked outputs alone, so tools that
+     * synchronize by modification time don't see them change.
+     */
+    const struct timespec lastUsed[2] = {{0, UTIME_NOW}, {0, UTIME_OMIT}};
+    ::utimensat(AT_FDCWD, entry.c_str(), lastUsed, 0);
+    ++hitCount;
+
+    return true;
+}
+
+/*
+ * The entry is a copy of the output rather than a link to it, so a later edit
+ * of the output can't change the cached rendition. Copying to a process unique
+ * temporary name and renaming it publishes the entry atomically.
+ */
+void RenditionCache::insert(const std::string& key, const std::string& outputName)
+{
+    std::error_code ec;
+    fs::path entry = entryPath(key);
+    fs::path tempFile = cacheDir / (tempFilePrefix + std::to_string(::getpid()) + "-" +
+        std::to_string(tempFileCounter++) + "-" + key);
+
+    fs::copy_file(outputName, tempFile, fs::copy_options::overwrite_existing, ec);
+    if (!ec)
+    {
+        fs::rename(tempFile, entry, ec);
+    }
+
+    if (ec)
+    {
+        fs::remove(tempFile, ec);
+        return;
+    }
+
+    std::uintmax_t entrySize = fs::file_size(entry, ec);
+    if (!ec)
+    {
+        cachedBytes += entrySize;
+    }
+
+    if (maxBytes == 0)
+    {
+        return;
+    }
+
+    /*
+     * This process only counts its own inserts, a periodic rescan picks up the
+     * entries added by the other processes.
+     */
+    const auto now = std::chrono::steady_clock::now().time_since_epoch().count();
+    auto lastScan = lastScanTime.load();
+    const bool rescanDue = now - lastScan >
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(cacheRescanInterval).count() &&
+        lastScanTime.compare_exchange_strong(lastScan, now);
+
+    if (rescanDue || cachedBytes.load() > maxBytes)
+    {
+        cachedBytes = evictLeastRecentlyUsed(maxBytes, maxBytes * evictionLowWaterPercent / 100);
+    }
+}
+
+/*
+ * Other processes may be using the cache at the same time, any entry may
+ * disappear while the directory is being scanned so every error is ignored.
+ * When the cache holds more than limitBytes entries are evicted until it
+ * holds targetBytes. Returns the number of bytes remaining in the cache.
+ */
+std::uintmax_t RenditionCache::evictLeastRecentlyUsed(std::uintmax_t limitBytes, std::uintmax_t targetBytes)
+{
+    std::lock_guard<std::mutex> evictionLock(evictionMutex);
+    lastScanTime = std::chrono::steady_clock::now().time_since_epoch().count();
+    std::vector<CacheEntry> entries;
+    std::uintmax_t totalBytes = 0;
+    std::error_code ec;
+    const auto now = fs::file_time_type::clock::now();
+
+    for (auto it = fs::directory_iterator(cacheDir, ec); !ec && it != fs::directory_iterator();
+        it.increment(ec))
+    {
+        std::error_code entryEc;
+        if (!it->is_regular_file(entryEc))
+        {
+            continue;
+        }
+
+        const fs::path& path = it->path();
+        fs::file_time_type lastWritten = it->last_write_time(entryEc);
+        std::uintmax_t size = it->file_size(entryEc);
+        if (entryEc)
+        {
+            continue;
+        }
+
+        if (path.filename().string().starts_with(tempFilePrefix))
+        {
+            if (now - lastWritten > abandonedTempFileAge)
+            {
+                fs::remove(path, entryEc);
+            }
+            continue;
+        }
+
+        struct stat entryStatus;
+        if (path.extension() == entryExtension && ::stat(path.c_str(), &entryStatus) == 0)
+        {
+            entries.push_back({path, {entryStatus.st_atim.tv_sec, entryStatus.st_atim.tv_nsec}, size});
+            totalBytes += size;
+        }
+    }
+
+    if (limitBytes == 0 || totalBytes <= limitBytes)
+    {
+        return totalBytes;
+    }
+
+    std::ranges::sort(entries, {}, &CacheEntry::lastUsed);
+
+    for (const auto& entry: entries)
+    {
+        if (totalBytes <= targetBytes)
+        {
+            break;
+        }
+
+        std::error_code removeEc;
+        fs::remove(entry.path, removeEc);
+        totalBytes -= entry.size;
+    }
+
+    return totalBytes;
+}
+
+std::string RenditionCache::statisticsReport() const
+{
+    return "Rendition cache: " + std::to_string(hits()) + " hits, " +
+        std::to_string(misses()) + " misses\n";
+}
@@ -0,0 +1,51 @@
+#ifndef RENDITIONCACHE_H_
+#define RENDITIONCACHE_H_
+
+/*
+ * On disk cache of resized photos. Each cache entry is keyed by a SHA-256 of
+ * the input photo's content and a normalized description of how the photo was
+ * resized and encoded, so the same rendition requested by different jobs is
+ * only computed once. Entries are published with an atomic rename so several
+ * processes can share one cache directory. A cached rendition is reflinked or
+ * copied to the output; hardlinking is optional because editing a hardlinked
+ * output in place also changes the cache.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class RenditionCache
+{
+public:
+    RenditionCache(const std::string& cacheDirectory, std::uintmax_t maxCacheBytes, bool hardlinkOutputs);
+
+    bool isEnabled() const noexcept { return enabled; }
+    std::string makeKey(const std::vector<unsigned char>& inputPhoto, const std::string& settings) const;
+    bool materialize(const std::string& key, const std::string& outputName);
+    void insert(const std::string& key, const std::string& outputName);
+    std::size_t hits() const noexcept { return hitCount.load(); }
+    std::size_t misses() const noexcept { return missCount.load(); }
+    std::string statisticsReport() const;
+
+private:
+    std::filesystem::path entryPath(const std::string& key) const;
+    std::uintmax_t evictLeastRecentlyUsed(std::uintmax_t limitBytes, std::uintmax_t targetBytes);
+
+    bool enabled = false;
+    std::filesystem::path cacheDir;
+    std::uintmax_t maxBytes = 0;
+    bool linkOutputs = false;
+    std::atomic<std::uintmax_t> cachedBytes = 0;
+    std::atomic<std::size_t> hitCount = 0;
+    std::atomic<std::size_t> missCount = 0;
+    std::atomic<std::size_t> tempFileCounter = 0;
+    std::atomic<std::chrono::steady_clock::rep> lastScanTime = 0;
+    std::mutex evictionMutex;
+};
+
+#endif // RENDITIONCACHE_H_
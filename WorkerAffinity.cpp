@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "WorkerAffinity.h"
+
+namespace fs = std::filesystem;
+
+static const fs::path numaNodeDirectory = "/sys/devices/system/node";
+
+// Parse a kernel cpu list such as "0-3,8-11".
+static std::vector<int> parseCpuList(const std::string& cpuList)
+{
+    std::vector<int> cpus;
+    std::istringstream ranges(cpuList);
+    std::string range;
+
+    while (std::getline(ranges, range, ','))
+    {
+        if (range.empty() || !std::isdigit(static_cast<unsigned char>(range[0])))
+        {
+            continue;
+        }
+
+        std::size_t dash = range.find('-');
+        int first = std::stoi(range.substr(0, dash));
+        int last = (dash == std::string::npos) ? first : std::stoi(range.substr(dash + 1));
+        for (int cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back(cpu);
+        }
+    }
+
+    return cpus;
+}
+
+static std::vector<std::vector<int>> findNumaNodeCpus(const cpu_set_t& allowedCpus)
+{
+    std::vector<std::vector<int>> nodes;
+    std::error_code ec;
+
+    for (auto it = fs::directory_iterator(numaNodeDirectory, ec); !ec && it != fs::directory_iterator();
+        it.increment(ec))
+    {
+        std::string name = it->path().filename().string();
+        if (!name.starts_with("node") || name.size() == 4 || !std::isdigit(static_cast<unsigned char>(name[4])))
+        {
+            continue;
+        }
+
+        std::ifstream cpuListFile(it->path() / "cpulist");
+        std::string cpuList;
+        std::getline(cpuListFile, cpuList);
+
+        std::vector<int> nodeCpus;
+        for (int cpu: parseCpuList(cpuList))
+        {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowedCpus))
+            {
+                nodeCpus.push_back(cpu);
+            }
+        }
+
+        if (!nodeCpus.empty())
+        {
+            nodes.push_back(nodeCpus);
+        }
+    }
+
+    return nodes;
+}
+
+std::vector<int> findWorkerCpus()
+{
+    std::vector<int> workerCpus;
+    cpu_set_t allowedCpus;
+
+    CPU_ZERO(&allowedCpus);
+    if (sched_getaffinity(0, sizeof(allowedCpus), &allowedCpus) != 0)
+    {
+        return workerCpus;
+    }
+
+    std::vector<std::vector<int>> nodes = findNumaNodeCpus(allowedCpus);
+    if (nodes.empty())
+    {
+        // No NUMA information, use the allowed CPUs in order.
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (CPU_ISSET(cpu, &allowedCpus))
+            {
+                workerCpus.push_back(cpu);
+            }
+        }
+        return workerCpus;
+    }
+
+    std::size_t largestNode = std::ranges::max(nodes, {}, &std::vector<int>::size).size();
+    for (std::size_t i = 0; i < largestNode; ++i)
+    {
+        for (const auto& node: nodes)
+        {
+            if (i < node.size())
+            {
+                workerCpus.push_back(node[i]);
+            }
+        }
+    }
+
+    return workerCpus;
+}
+
+bool pinCurrentThreadToCpu(int cpu)
+{
+    cpu_set_t cpuSet;
+
+    CPU_ZERO(&cpuSet);
+    CPU_SET(cpu, &cpuSet);
+
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+}
@@ -0,0 +1,16 @@
+#ifndef WORKERAFFINITY_H_
+#define WORKERAFFINITY_H_
+
+/*
+ * CPU affinity for the resize worker threads. The CPUs this process may run
+ * on are ordered round robin across NUMA nodes, so worker N is pinned to
+ * workerCpus[N % workerCpus.size()] and any number of workers is spread over
+ * every memory controller.
+ */
+
+#include <vector>
+
+std::vector<int> findWorkerCpus();
+bool pinCurrentThreadToCpu(int cpu);
+
+#endif // WORKERAFFINITY_H_
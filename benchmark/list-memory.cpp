@@ -0,0 +1,66 @@
+/*
+ * Measures the memory buildPhotoInputAndOutputList() uses for a directory of
+ * photos, so PhotoFileList::memoryUsage() can be checked against the
+ * allocator. Built and run by benchmark/list-memory.sh.
+ *
+ * Usage: list-memory SOURCE_DIR TARGET_DIR [OUTPUT_EXTENSION]
+ *
+ * Prints the number of photos, the list's own estimate, the bytes still
+ * allocated after the list was built and the growth of the peak resident set
+ * while it was built, separated by tabs.
+ */
+
+#include <cstdlib>
+#include "FileOptions.h"
+#include <iostream>
+#include <malloc.h>
+#include "photofilefinder.h"
+#include "PhotoFileList.h"
+#include <sys/resource.h>
+
+static std::size_t peakResidentBytes()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+
+    return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+}
+
+static std::size_t allocatedBytes()
+{
+    const struct mallinfo2 allocator = mallinfo2();
+
+    // The large arrays of the list are allocated with mmap() outside the heap.
+    return allocator.uordblks + allocator.hblkhd;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " SOURCE_DIR TARGET_DIR [OUTPUT_EXTENSION]\n";
+        return EXIT_FAILURE;
+    }
+
+    FileOptions fileOptions;
+    fileOptions.sourceDirectory = argv[1];
+    fileOptions.targetDirectory = argv[2];
+    if (argc > 3)
+    {
+        // Fills the set of output files used to find photos saved to the same file.
+        fileOptions.outputExtension = argv[3];
+    }
+
+    const std::size_t peakBefore = peakResidentBytes();
+    const std::size_t allocatedBefore = allocatedBytes();
+
+    PhotoFileList photoFiles = buildPhotoInputAndOutputList(fileOptions);
+
+    const std::size_t allocatedDelta = allocatedBytes() - allocatedBefore;
+    const std::size_t peakDelta = peakResidentBytes() - peakBefore;
+
+    std::cout << photoFiles.size() << '\t' << photoFiles.memoryUsage() << '\t' << allocatedDelta << '\t' <<
+        peakDelta << '\n';
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,60 @@
+#!/usr/bin/env bash
+#
+# Measure how much memory the photo list takes per photo, to check the
+# estimate PhotoFileList::memoryUsage() reports under --time-resize against
+# the allocator and the peak resident set size.
+#
+# Usage: benchmark/list-memory.sh [WORK_DIR]
+#
+# A directory of COUNTS (default "10000 100000 1000000") empty camera named
+# .jpg files is generated once for each count in WORK_DIR. Only the list is
+# built, so OpenCV isn't needed; the driver is compiled with CXX (default
+# g++) and needs glibc for mallinfo2(). Each count is measured keeping the
+# input extension and with --output-format .webp, which also fills the set
+# used to find photos that would be saved to the same file.
+
+set -euo pipefail
+
+repoDir=$(cd "$(dirname "$0")/.." && pwd)
+workDir=${1:-/tmp/photoresize-list-memory}
+counts=${COUNTS:-10000 100000 1000000}
+
+mkdir -p "$workDir"
+driver=$workDir/list-memory
+"${CXX:-g++}" -std=c++23 -O2 -I"$repoDir" "$repoDir/benchmark/list-memory.cpp" \
+    "$repoDir/photofilefinder.cpp" "$repoDir/PhotoFileList.cpp" "$repoDir/PhotoArchive.cpp" -o "$driver"
+
+makePhotos()
+{
+    local count=$1 photos=$2
+    if [[ ! -f $photos/.complete ]]; then
+        rm -rf "$photos"
+        mkdir -p "$photos"
+        (cd "$photos" && seq -f 'IMG_20240101_%06g.jpg' 0 $((count - 1)) | xargs touch)
+        touch "$photos/.complete"
+    fi
+}
+
+report()
+{
+    local label=$1 photos=$2
+    shift 2
+    local output=$workDir/output
+    rm -rf "$output"
+    mkdir -p "$output"
+
+    "$driver" "$photos" "$output" "$@" | awk -v label="$label" -F '\t' \
+        '$1 > 0 { printf "| %-24s | %9d | %9.1f | %9.1f | %9.1f |\n", label, $1, $2 / $1, $3 / $1, $4 / $1 }'
+}
+
+echo "Bytes per photo"
+echo
+echo "| Configuration            | Photos    | Estimate  | Allocated | Peak RSS  |"
+echo "|--------------------------|-----------|-----------|-----------|-----------|"
+
+for count in $counts; do
+    photos=$workDir/photos-$count
+    makePhotos "$count" "$photos"
+    report "same extension" "$photos"
+    report "--output-format .webp" "$photos" .webp
+done
@@ -0,0 +1,93 @@
+#!/usr/bin/env bash
+#
+# Compare the throughput of resizing a mixed size corpus with the inter and
+# intra image execution policy against the default behavior of an earlier
+# build, which resized one photo at a time using OpenCV's own thread pool.
+#
+# Usage: benchmark/mixed-size-throughput.sh NEW_BINARY [BASELINE_BINARY] [WORK_DIR]
+#
+# The corpus is generated once with ImageMagick in WORK_DIR/corpus: many
+# camera sized photos, some 12 megapixel photos and a few panoramas above the
+# default --intra-image-mp threshold. Each configuration is run RUNS times
+# (default 3) and the median is reported.
+
+set -euo pipefail
+
+if [[ $# -lt 1 ]]; then
+    echo "Usage: $0 NEW_BINARY [BASELINE_BINARY] [WORK_DIR]" >&2
+    exit 1
+fi
+
+newBinary=$1
+baselineBinary=${2:-}
+workDir=${3:-/tmp/photoresize-benchmark}
+runs=${RUNS:-3}
+
+corpus=$workDir/corpus
+output=$workDir/output
+
+if command -v magick > /dev/null; then
+    imageMagick=(magick)
+elif command -v convert > /dev/null; then
+    imageMagick=(convert)
+else
+    echo "ImageMagick is needed to generate the corpus" >&2
+    exit 1
+fi
+
+makePhotos()
+{
+    local count=$1 width=$2 height=$3 name=$4
+    for ((i = 0; i < count; ++i)); do
+        local photo=$corpus/${name}_$i.jpg
+        if [[ ! -f $photo ]]; then
+            "${imageMagick[@]}" -size "${width}x${height}" -seed "$i" plasma:fractal \
+                -quality 90 "$photo"
+        fi
+    done
+}
+
+mkdir -p "$corpus"
+makePhotos 240 1600 1200 small
+makePhotos 40 4000 3000 medium
+makePhotos 4 12000 6000 panorama
+
+photoCount=$(find "$corpus" -name '*.jpg' | wc -l)
+corpusMBytes=$(du -sm "$corpus" | cut -f1)
+
+# Print the median wall clock seconds of resizing the whole corpus.
+timeResize()
+{
+    local times=()
+    for ((run = 0; run < runs; ++run)); do
+        rm -rf "$output"
+        mkdir -p "$output"
+        local start end
+        start=$(date +%s.%N)
+        "$@" --source-dir "$corpus" --save-dir "$output" --all-jpg-files --max-width 1024 \
+            --maintain-ratio > /dev/null
+        end=$(date +%s.%N)
+        times+=("$(echo "$end - $start" | bc)")
+    done
+    printf '%s\n' "${times[@]}" | sort -n | sed -n "$(( (runs + 1) / 2 ))p"
+}
+
+report()
+{
+    local label=$1 seconds=$2
+    printf '| %-38s | %8.2f | %8.1f |\n' "$label" "$seconds" "$(echo "$photoCount / $seconds" | bc -l)"
+}
+
+echo "$photoCount photos, $corpusMBytes MB, $(nproc) CPUs, median of $runs runs"
+echo
+echo "| Configuration                          | Seconds  | Photos/s |"
+echo "|----------------------------------------|----------|----------|"
+
+if [[ -n $baselineBinary ]]; then
+    report "baseline, one photo at a time" "$(timeResize "$baselineBinary")"
+fi
+report "--threads 1" "$(timeResize "$newBinary" --threads 1)"
+report "inter image only (--intra-image-mp 0)" "$(timeResize "$newBinary" --intra-image-mp 0)"
+report "hybrid (default)" "$(timeResize "$newBinary")"
+report "hybrid, --pin-threads" "$(timeResize "$newBinary" --pin-threads)"
+report "hybrid, --job-order largest-first" "$(timeResize "$newBinary" --job-order largest-first)"
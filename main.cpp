@@ -1,9 +1,15 @@
 #include "CommandLineParser.h"
 #include <iostream>
+#include <memory>
+#include "PackFile.h"
+#include "PhotoArchive.h"
 #include "PhotoFileList.h"
 #include "photofilefinder.h"
 #include "PhotoResizer.h"
+#include "ProgressMetrics.h"
+#include "RenditionCache.h"
 #include "UtilityTimer.h"
+#include <vector>
 
 int main(int argc, char* argv[])
 {
@@ -16,11 +22,32 @@ int main(int argc, char* argv[])
 		if (const auto progOptions = parseCommandLine(argc, argv); progOptions.has_value())
 		{
 			ProgramOptions programOptions = *progOptions;
-			PhotoFileList photoFiles = buildPhotoInputAndOutputList(programOptions.fileOptions);
+			// The photos of an archive are listed while they are resized.
+			const bool fromArchive = PhotoArchive::isArchive(programOptions.fileOptions.sourceDirectory);
+			PhotoFileList photoFiles = fromArchive ? PhotoFileList() :
+				buildPhotoInputAndOutputList(programOptions.fileOptions);
+			RenditionCache renditionCache(programOptions.fileOptions.cacheDirectory,
+				programOptions.fileOptions.maxCacheMBytes * 1024 * 1024,
+				programOptions.fileOptions.hardlinkFromCache);
+			std::unique_ptr<PackWriter> packWriter;
+			if (!programOptions.fileOptions.packBaseName.empty())
+			{
+				packWriter = std::make_unique<PackWriter>(programOptions.fileOptions.packBaseName,
+					programOptions.fileOptions.maxPackMBytes * 1024 * 1024);
+				if (!packWriter->isOpen())
+				{
+					return EXIT_FAILURE;
+				}
+			}
+			ProgressMetrics metrics(photoFiles.size(), programOptions.executionOptions);
 			UtilityTimer stopWatch;
 
-			std::size_t resizeCount = resizeAllPhotosInList(
-				programOptions.photoOptions, photoFiles);
+			std::size_t resizeCount = fromArchive ?
+				resizeAllPhotosInArchive(programOptions.photoOptions, programOptions.executionOptions,
+					programOptions.fileOptions, photoFiles, renditionCache, metrics, packWriter.get()) :
+				resizeAllPhotosInList(programOptions.photoOptions, programOptions.executionOptions,
+					photoFiles, renditionCache, metrics, packWriter.get());
+			metrics.finish();
 			if (resizeCount != photoFiles.size())
 			{
 				std::cerr << "Not all photos were resized\n";
@@ -30,6 +57,36 @@ int main(int argc, char* argv[])
 			std::string report(std::to_string(resizeCount) + " of " + 
 				std::to_string(photoFiles.size()) + " photos resized\n");
 
+			if (programOptions.fileOptions.verifyPack)
+			{
+				// Every append has been written once the writer is closed.
+				packWriter.reset();
+				PackReader packReader(programOptions.fileOptions.packBaseName);
+				const std::vector<std::string> damaged = packReader.findDamaged();
+				for (const auto& name: damaged)
+				{
+					std::cerr << "The packed photo " << name << " is damaged!\n";
+				}
+				report += "Pack: " + std::to_string(packReader.size()) + " photos checked, " +
+					std::to_string(damaged.size()) + " damaged\n";
+				if (!damaged.empty())
+				{
+					executionStatus = EXIT_FAILURE;
+				}
+			}
+			report += metrics.bytesSavedReport();
+			report += metrics.trialEncodeReport();
+
+			if (programOptions.enableExecutionTime && !photoFiles.empty())
+			{
+				report += "Photo list: about " + std::to_string(photoFiles.memoryUsage()) + " bytes, " +
+					std::to_string(photoFiles.memoryUsage() / photoFiles.size()) + " bytes per photo\n";
+			}
+			if (renditionCache.isEnabled())
+			{
+				report += renditionCache.statisticsReport();
+			}
+
 			if (programOptions.enableExecutionTime)
 			{
 				stopWatch.stopTimerAndReport(report);
@@ -1,14 +1,20 @@
 #include <algorithm>
 #include <cctype>
+#include <cstdint>
 #include "FileOptions.h"
 #include <filesystem>
 #include <iostream>
 #include <iterator>
+#include <optional>
+#include "PhotoArchive.h"
 #include "photofilefinder.h"
 #include "PhotoFileList.h"
 #include <ranges>
 #include <string>
+#include <string_view>
+#include <system_error>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 // std::filesystem can make lines very long.
@@ -16,7 +22,83 @@ namespace fs = std::filesystem;
 
 using DirectoryMap = std::unordered_map<std::string, fs::path>;
 
-using InputPhotoList = std::vector<fs::path>;
+/*
+ * The output files already assigned to a photo in this run. The set holds the
+ * indexes of the photos in the list rather than copies of their names, the
+ * names are looked up in the list's arena. The output file name is relative to
+ * the target directory, for archive members it includes the member's
+ * directory. Different photos can only have the same output file when the
+ * output names are changed or an archive has a member twice, otherwise the
+ * set is left empty.
+ */
+class OutputFileSet
+{
+public:
+    OutputFileSet(const PhotoFileList& photoList, bool collisionsPossible)
+        : photos{photoList}, enabled{collisionsPossible},
+        assigned{0, NameHash{photoList}, NameEqual{photoList}}
+    {
+    }
+
+    bool contains(std::string_view outputFileName) const
+    {
+        return enabled && assigned.contains(outputFileName);
+    }
+
+    // Called after the photo has been added to the list.
+    void add(std::size_t photoIndex)
+    {
+        if (enabled && photos[photoIndex].hasOutput())
+        {
+            assigned.insert(static_cast<std::uint32_t>(photoIndex));
+        }
+    }
+
+private:
+    struct NameHash
+    {
+        using is_transparent = void;
+
+        std::size_t operator()(std::string_view outputFileName) const noexcept
+        {
+            return std::hash<std::string_view>{}(outputFileName);
+        }
+        std::size_t operator()(std::uint32_t photoIndex) const noexcept
+        {
+            return (*this)(photoList[photoIndex].outputFileName());
+        }
+
+        const PhotoFileList& photoList;
+    };
+
+    struct NameEqual
+    {
+        using is_transparent = void;
+
+        std::string_view name(std::string_view outputFileName) const noexcept { return outputFileName; }
+        std::string_view name(std::uint32_t photoIndex) const noexcept
+        {
+            return photoList[photoIndex].outputFileName();
+        }
+
+        bool operator()(const auto& left, const auto& right) const noexcept
+        {
+            return name(left) == name(right);
+        }
+
+        const PhotoFileList& photoList;
+    };
+
+    const PhotoFileList& photos;
+    const bool enabled;
+    std::unordered_set<std::uint32_t, NameHash, NameEqual> assigned;
+};
+
+// Only changed output names or an archive can map two photos to one output file.
+static bool outputCollisionsPossible(const FileOptions& fileOptions, bool fromArchive)
+{
+    return fromArchive || fileOptions.fixFileName || !fileOptions.outputExtension.empty();
+}
 
 struct FindDirectoryData
 {
@@ -62,45 +144,14 @@ static DirectoryMap findAllDirectories(FileOptions& fileOptions)
         dirMap.insert({fDDi.mapIndex, foundDir});
         if (fDDi.mapIndex == "SourceDir")
         {
-            defaultDir = foundDir;
+            // Photos read from an archive are saved next to the archive by default.
+            defaultDir = PhotoArchive::isArchive(foundDir) ? foundDir.parent_path() : foundDir;
         }
     }
 
     return dirMap;
 }
 
-static void addFilesToListByExtension(std::filesystem::path& cwd, const std::string& extLC, 
-        const std::string& extUC, InputPhotoList& photoList)
-{
-    auto is_match = [extLC, extUC](auto f) {
-        return f.path().extension().string() == extLC ||
-            f.path().extension().string() == extUC;
-    };
-
-    auto files = fs::directory_iterator{ cwd }
-        | std::views::filter([](auto& f) { return f.is_regular_file(); })
-        | std::views::filter(is_match);
-
-    std::ranges::copy(files, std::back_inserter(photoList));
-}
-
-static InputPhotoList findAllPhotos(fs::path& originsDir, FileOptions& fileOptions)
-{
-    InputPhotoList tempFileList;
-
-    if (fileOptions.processJPGFiles)
-    {
-        addFilesToListByExtension(originsDir, ".jpg", ".JPG", tempFileList);
-    }
-
-    if (fileOptions.processPNGFiles)
-    {
-        addFilesToListByExtension(originsDir, ".png", ".PNG", tempFileList);
-    }
-
-    return tempFileList;
-}
-
 static std::string makeFileNameWebSafe(const std::string& inName)
 {
     std::string webSafeName;
@@ -112,13 +163,23 @@ static std::string makeFileNameWebSafe(const std::string& inName)
     return webSafeName;
 }
 
+/*
+ * Returns the output file name relative to the target directory, which is
+ * only the file name unless the photo is saved in the subdirectory outputDir.
+ * The name is empty when the output exists and --overwrite wasn't specified,
+ * or when an earlier photo in this run has the same output file. With
+ * --output-format a.jpg and a.png or a.jpg and a.JPG are both saved as a.jpg.
+ */
 static std::string makeOutputFileName(
     const fs::path& inputFile,
     const fs::path& targetDir,
-    FileOptions& fileOptions
+    const fs::path& outputDir,
+    FileOptions& fileOptions,
+    const OutputFileSet& outputFiles
 )
 {
-    std::string ext = inputFile.extension().string();
+    std::string ext = fileOptions.outputExtension.empty() ?
+        inputFile.extension().string() : fileOptions.outputExtension;
     std::string outputFileName = inputFile.stem().string();
 
     if (fileOptions.fixFileName)
@@ -133,38 +194,166 @@ static std::string makeOutputFileName(
 
     outputFileName += ext;
 
+    outputFileName = (outputDir / outputFileName).string();
     fs::path targetFile = targetDir;
     targetFile.append(outputFileName);
 
-    if (fs::exists(targetFile) && !fileOptions.overWriteFiles)
+    if (outputFiles.contains(outputFileName))
+    {
+        std::cerr << "Warning: " << inputFile << " would overwrite the resized copy of another photo: " <<
+            targetFile << ", it is skipped.\n";
+        outputFileName.clear();
+    }
+    // Packed renditions are appended, a later entry replaces an earlier one.
+    else if (fileOptions.packBaseName.empty() && fs::exists(targetFile) && !fileOptions.overWriteFiles)
     {
         std::cerr << "Warning: Attempting to overwrite existing file: " << targetFile << ". Use \'--overwrite\' to overwrite files.\n";
-        targetFile.clear();
+        outputFileName.clear();
     }
 
-    return targetFile.string();
+    return outputFileName;
 }
 
-static PhotoFileList copyInFileNamesToPhotoListAddOutFileNames(
-    FileOptions& fileOptions,
-    InputPhotoList& inFileList,
-    fs::path& targetDir
-)
+/*
+ * Photos are added to the list as the directory is read, the directory names
+ * are stored once by the list.
+ */
+static void addPhotosToListByExtension(const fs::path& sourceDir, const std::string& extLC,
+    const std::string& extUC, const fs::path& targetDir, FileOptions& fileOptions,
+    OutputFileSet& outputFiles, PhotoFileList& photoList)
+{
+    const std::string sourceDirName = sourceDir.string();
+    const std::string targetDirName = targetDir.string();
+
+    auto is_match = [extLC, extUC](auto& f) {
+        return f.path().extension().string() == extLC ||
+            f.path().extension().string() == extUC;
+    };
+
+    auto files = fs::directory_iterator{ sourceDir }
+        | std::views::filter([](auto& f) { return f.is_regular_file(); })
+        | std::views::filter(is_match);
+
+    for (auto const& file: files)
+    {
+        const fs::path& inputFile = file.path();
+        photoList.addPhoto(sourceDirName, inputFile.filename().string(), targetDirName,
+            makeOutputFileName(inputFile, targetDir, fs::path(), fileOptions, outputFiles));
+        outputFiles.add(photoList.size() - 1);
+    }
+}
+
+static bool isSelectedPhoto(const fs::path& file, const FileOptions& fileOptions)
+{
+    const std::string ext = file.extension().string();
+
+    return (fileOptions.processJPGFiles && (ext == ".jpg" || ext == ".JPG")) ||
+        (fileOptions.processPNGFiles && (ext == ".png" || ext == ".PNG"));
+}
+
+/*
+ * A member keeps its directory inside the archive below the target directory,
+ * cameras reuse file names so day1/IMG_0001.jpg and day2/IMG_0001.jpg are
+ * different photos. Members that would be saved outside the target directory
+ * have no output directory.
+ */
+static std::optional<fs::path> findMemberOutputDirectory(const fs::path& member, const FileOptions& fileOptions)
+{
+    const fs::path memberDir = member.parent_path().lexically_normal();
+    fs::path outputDir;
+
+    if (member.has_root_path())
+    {
+        return std::nullopt;
+    }
+
+    for (const auto& component: memberDir)
+    {
+        if (component == "..")
+        {
+            return std::nullopt;
+        }
+        if (component.empty() || component == ".")
+        {
+            continue;
+        }
+
+        outputDir /= fileOptions.fixFileName ? fs::path(makeFileNameWebSafe(component.string())) : component;
+    }
+
+    return outputDir;
+}
+
+static PhotoFileList findAllPhotosInArchive(const fs::path& sourceArchive, const fs::path& targetDir,
+    FileOptions& fileOptions, const ArchivePhotoReader& readArchivePhoto)
 {
     PhotoFileList photoFileList;
+    const std::string sourceArchiveName = sourceArchive.string();
+    const std::string targetDirName = targetDir.string();
+    PhotoArchive archive(sourceArchiveName);
+    std::string memberName;
+    OutputFileSet outputFiles(photoFileList, outputCollisionsPossible(fileOptions, true));
 
-    for (auto const& file: inFileList)
+    while (archive.nextMember(memberName))
     {
-        PhotoFile currentPhoto;
-        currentPhoto.inputName = file.string();
-        currentPhoto.outputName = makeOutputFileName(file, targetDir, fileOptions);
-        photoFileList.push_back(currentPhoto);
+        fs::path member(memberName);
+        if (!isSelectedPhoto(member, fileOptions))
+        {
+            continue;
+        }
+
+        std::string outputFileName;
+        const auto memberDir = findMemberOutputDirectory(member, fileOptions);
+        std::error_code ec;
+        if (!memberDir)
+        {
+            std::cerr << "Warning: The archive member " << memberName <<
+                " is outside of the archive, it is skipped.\n";
+        }
+        else if (!memberDir->empty() && fileOptions.packBaseName.empty() &&
+            !fs::create_directories(targetDir / *memberDir, ec) && ec)
+        {
+            std::cerr << "Warning: The directory " << targetDir / *memberDir << " can't be created: " <<
+                ec.message() << ", " << memberName << " is skipped.\n";
+        }
+        else
+        {
+            outputFileName = makeOutputFileName(member, targetDir, *memberDir, fileOptions, outputFiles);
+        }
+
+        photoFileList.addPhoto(sourceArchiveName, memberName, targetDirName, outputFileName);
+        outputFiles.add(photoFileList.size() - 1);
+        if (readArchivePhoto)
+        {
+            readArchivePhoto(archive, photoFileList[photoFileList.size() - 1]);
+        }
     }
 
     return photoFileList;
 }
 
-PhotoFileList buildPhotoInputAndOutputList(FileOptions& fileOptions)
+static PhotoFileList findAllPhotos(const fs::path& sourceDir, const fs::path& targetDir,
+    FileOptions& fileOptions)
+{
+    PhotoFileList photoFileList;
+    OutputFileSet outputFiles(photoFileList, outputCollisionsPossible(fileOptions, false));
+
+    if (fileOptions.processJPGFiles)
+    {
+        addPhotosToListByExtension(sourceDir, ".jpg", ".JPG", targetDir, fileOptions, outputFiles,
+            photoFileList);
+    }
+
+    if (fileOptions.processPNGFiles)
+    {
+        addPhotosToListByExtension(sourceDir, ".png", ".PNG", targetDir, fileOptions, outputFiles,
+            photoFileList);
+    }
+
+    return photoFileList;
+}
+
+PhotoFileList buildPhotoInputAndOutputList(FileOptions& fileOptions, const ArchivePhotoReader& readArchivePhoto)
 {
     PhotoFileList photoFileList;
     DirectoryMap directories = findAllDirectories(fileOptions);
@@ -177,17 +366,14 @@ PhotoFileList buildPhotoInputAndOutputList(FileOptions& fileOptions)
         }
     }
 
-    fs::path sourceDir = directories.find("SourceDir")->second;;
+    fs::path sourceDir = directories.find("SourceDir")->second;
+    fs::path targetDir = directories.find("TargetDir")->second;
 
-    InputPhotoList inputPhotoList = findAllPhotos(sourceDir, fileOptions);
-    
-    if (inputPhotoList.size())
-    {
-        fs::path targetDir = directories.find("TargetDir")->second;
-        photoFileList = copyInFileNamesToPhotoListAddOutFileNames(
-            fileOptions, inputPhotoList, targetDir);
-    }
-    else
+    photoFileList = PhotoArchive::isArchive(sourceDir) ?
+        findAllPhotosInArchive(sourceDir, targetDir, fileOptions, readArchivePhoto) :
+        findAllPhotos(sourceDir, targetDir, fileOptions);
+
+    if (photoFileList.empty())
     {
         std::cerr << "No photos found to resize!\n";
     }
@@ -2,8 +2,20 @@
 #define PHOTOFILEFINDER_H_
 
 #include "FileOptions.h"
+#include <functional>
 #include "PhotoFileList.h"
 
-PhotoFileList buildPhotoInputAndOutputList(FileOptions& fileOptions);
+class PhotoArchive;
+
+// Called while the archive is at the member of the photo just added to the list.
+using ArchivePhotoReader = std::function<void(PhotoArchive& archive, const PhotoFile& photo)>;
+
+/*
+ * The photos of an archive can only be read in the order they are stored, so
+ * they are handed to readArchivePhoto as the list is built and the archive is
+ * only decompressed once.
+ */
+PhotoFileList buildPhotoInputAndOutputList(FileOptions& fileOptions,
+    const ArchivePhotoReader& readArchivePhoto = {});
 
 #endif // PHOTOFILEFINDER_H_